@@ -0,0 +1,285 @@
+#include <iostream>
+#include <systemc>
+#include <string>
+#include <chrono>
+#include <new>
+#include <cerrno>
+#include <sched.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+using namespace sc_core;
+using namespace sc_dt;
+
+#include "axi_bridge.h"
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+	"the bridge needs lock free atomics in shared memory");
+
+// Anonymous shared mapping, inherited by the child of fork().
+
+bridge_shared_t* AXI_BRIDGE::create_shared()
+{
+	void* p = mmap(nullptr, sizeof(bridge_shared_t), PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (p == MAP_FAILED)
+	{
+		SC_REPORT_FATAL("AXI_BRIDGE", "Cannot map the shared memory");
+		return nullptr;
+	}
+
+	bridge_shared_t* shared = new (p) bridge_shared_t;
+	for (int i = 0; i < 2; i++)
+	{
+		shared->ring[i].head = 0;
+		shared->ring[i].tail = 0;
+		shared->stamp_ns[i] = 0;
+		shared->is_finished[i] = false;
+		shared->pid[i] = 0;
+	}
+	return shared;
+}
+
+void AXI_BRIDGE::end_of_elaboration()
+{
+	if (shared == nullptr || (partition != 0 && partition != 1))
+	{
+		SC_REPORT_FATAL("AXI_BRIDGE", "Bridge without shared memory or partition");
+	}
+	if (lookahead_ns < 1)
+	{
+		SC_REPORT_FATAL("AXI_BRIDGE", "The lookahead must be at least 1 ns");
+	}
+	if (shared->pid[0] <= 0 || shared->pid[1] <= 0)
+	{
+		SC_REPORT_FATAL("AXI_BRIDGE", "The pids of the partitions are not set");
+	}
+}
+
+void AXI_BRIDGE::thread_send()
+{
+	while(true)
+	{
+		axi_trans_handle_t handle = in.read();
+		const axi_trans_t& trans = *handle;
+		uint64_t stamp_now = sc_time_stamp().value() / 1000; // ps to ns convert.
+
+		// the other partition empties the ring at its next sync
+		while (!push(trans, stamp_now))
+		{
+			count_ring_full ++;
+			wait(event_synced);
+			stamp_now = sc_time_stamp().value() / 1000; // ps to ns convert.
+		}
+		count_sent ++;
+		log(__FUNCTION__, "SENT", AXI_BUS::transaction_to_string(trans));
+		axi_trans_free(handle);
+	}
+}
+
+// Every lookahead_ns: publish the time reached, wait until the other
+// partition has reached it too, then take what it has sent so far.
+// It sends nothing older afterwards, so nothing can arrive before
+// stamp_now + lookahead_ns that is not in q_arrival by now.
+
+void AXI_BRIDGE::thread_sync()
+{
+	int peer = 1 - partition;
+
+	while(true)
+	{
+		uint64_t stamp_now = sc_time_stamp().value() / 1000; // ps to ns convert.
+		shared->stamp_ns[partition].store(stamp_now, std::memory_order_release);
+		count_sync ++;
+
+		if (shared->stamp_ns[peer].load(std::memory_order_acquire) < stamp_now
+			&& !shared->is_finished[peer].load(std::memory_order_acquire))
+		{
+			count_sync_blocked ++;
+			auto wall_begin = std::chrono::steady_clock::now();
+			uint64_t count_spin = 0;
+			while (shared->stamp_ns[peer].load(std::memory_order_acquire) < stamp_now
+				&& !shared->is_finished[peer].load(std::memory_order_acquire))
+			{
+				sched_yield();
+				if (++count_spin % 65536 == 0 && is_peer_exited())
+				{
+					// it may have finished just before it exited
+					if (shared->is_finished[peer].load(std::memory_order_acquire))
+					{
+						break;
+					}
+					SC_REPORT_FATAL("AXI_BRIDGE", "The other partition has exited");
+				}
+			}
+			auto wall_end = std::chrono::steady_clock::now();
+			wall_blocked_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(wall_end - wall_begin).count();
+		}
+
+		receive();
+		event_synced.notify();
+		wait(lookahead_ns, SC_NS);
+	}
+}
+
+// The child stays a zombie until it is reaped, and kill() still finds a
+// zombie, so partition 0 reaps it here. The parent is reaped by init
+// once it is gone, so kill() does for partition 1.
+
+bool AXI_BRIDGE::is_peer_exited()
+{
+	if (partition == 0)
+	{
+		int status = 0;
+		pid_t pid_child = shared->pid[1];
+		return waitpid(pid_child, &status, WNOHANG) == pid_child;
+	}
+	return kill(shared->pid[0], 0) != 0 && errno == ESRCH;
+}
+
+void AXI_BRIDGE::thread_deliver()
+{
+	while(true)
+	{
+		if (q_arrival.empty())
+		{
+			wait(event_arrival);
+			continue;
+		}
+
+		uint64_t stamp_now = sc_time_stamp().value() / 1000; // ps to ns convert.
+		uint64_t stamp_due = q_arrival.front().first;
+		if (stamp_due > stamp_now)
+		{
+			wait(stamp_due - stamp_now, SC_NS, event_arrival);
+			continue;
+		}
+
+		out.write(q_arrival.front().second);
+		log(__FUNCTION__, "DELIVERED", AXI_BUS::transaction_to_string(*q_arrival.front().second));
+		q_arrival.pop_front();
+		count_received ++;
+	}
+}
+
+bool AXI_BRIDGE::push(const axi_trans_t& trans, uint64_t stamp_ns)
+{
+	bridge_ring_t& ring = shared->ring[partition];
+	uint64_t tail = ring.tail.load(std::memory_order_relaxed);
+	if (tail - ring.head.load(std::memory_order_acquire) >= BRIDGE_RING_SLOTS)
+	{
+		return false;
+	}
+
+	bridge_message_t& message = ring.slots[tail % BRIDGE_RING_SLOTS];
+	message.stamp_ns = stamp_ns;
+	message.addr = trans.addr;
+	message.length = trans.length;
+	message.burst = trans.burst;
+	message.size = trans.size;
+	message.is_write = trans.is_write;
+	for (int i = 0; i < trans.length; i++)
+	{
+		for (int lane = 0; lane < BUS_BYTES; lane++)
+		{
+			message.data[i * BUS_BYTES + lane] = (uint8_t) trans.data[i].range(lane * 8 + 7, lane * 8).to_uint64();
+		}
+		message.strb[i] = trans.strb[i];
+	}
+
+	ring.tail.store(tail + 1, std::memory_order_release);
+	return true;
+}
+
+// everything the other partition has sent so far, in order of sending
+
+void AXI_BRIDGE::receive()
+{
+	bridge_ring_t& ring = shared->ring[1 - partition];
+	uint64_t head = ring.head.load(std::memory_order_relaxed);
+	uint64_t tail = ring.tail.load(std::memory_order_acquire);
+	if (head == tail)
+	{
+		return;
+	}
+
+	for (; head != tail; head++)
+	{
+		const bridge_message_t& message = ring.slots[head % BRIDGE_RING_SLOTS];
+		axi_trans_handle_t handle = axi_trans_alloc();
+		axi_trans_t& trans = *handle;
+		trans.addr = message.addr;
+		trans.length = message.length;
+		trans.burst = message.burst;
+		trans.size = message.size;
+		trans.is_write = message.is_write;
+		for (int i = 0; i < trans.length; i++)
+		{
+			trans.data[i] = 0;
+			for (int lane = 0; lane < BUS_BYTES; lane++)
+			{
+				trans.data[i].range(lane * 8 + 7, lane * 8) = message.data[i * BUS_BYTES + lane];
+			}
+			trans.strb[i] = message.strb[i];
+		}
+		q_arrival.emplace_back(message.stamp_ns + lookahead_ns, handle);
+		log(__FUNCTION__, "RECEIVED", AXI_BUS::transaction_to_string(trans));
+	}
+
+	ring.head.store(head, std::memory_order_release);
+	event_arrival.notify(SC_ZERO_TIME);
+}
+
+// After sc_start() returns, the other partition no longer waits for this one.
+
+void AXI_BRIDGE::finish()
+{
+	shared->stamp_ns[partition].store(UINT64_MAX, std::memory_order_release);
+	shared->is_finished[partition].store(true, std::memory_order_release);
+}
+
+void AXI_BRIDGE::report_stats()
+{
+	std::cout << "BRIDGE " << name() << ": partition=" << partition
+		<< ", lookahead=" << lookahead_ns << " ns"
+		<< ", sent=" << count_sent
+		<< ", received=" << count_received
+		<< ", ring_full=" << count_ring_full << std::endl;
+	std::cout << "BRIDGE " << name() << ": syncs=" << count_sync
+		<< ", blocked_syncs=" << count_sync_blocked
+		<< ", wall_blocked=" << wall_blocked_ns / 1000000.0 << " ms" << std::endl;
+}
+
+// The manager side is idle when every request has its response. The
+// subordinate side is idle once the manager side has finished.
+
+bool AXI_BRIDGE::is_idle()
+{
+	bool is_local_idle = q_arrival.empty() && in->num_available() == 0;
+	if (partition == 0)
+	{
+		return is_local_idle && count_sent == count_received;
+	}
+	return is_local_idle && shared->is_finished[0].load(std::memory_order_acquire);
+}
+
+void AXI_BRIDGE::report_outstanding()
+{
+	std::cout << "BRIDGE " << name() << ": sent=" << count_sent
+		<< ", received=" << count_received
+		<< ", arriving=" << q_arrival.size() << std::endl;
+	for (const auto& arrival : q_arrival)
+	{
+		std::cout << "BRIDGE " << name() << ":   at " << arrival.first << " ns "
+			<< AXI_BUS::transaction_to_string(*arrival.second) << std::endl;
+	}
+}
+
+void AXI_BRIDGE::log(std::string source, std::string action, std::string detail)
+{
+	std::string sep = ":";
+	std::string log_source = "BRIDGE" + sep + name() + sep + source;
+	AXI_BUS::log(log_source, action, detail);
+}
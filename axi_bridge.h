@@ -0,0 +1,111 @@
+#ifndef __AXI_BRIDGE_H__
+#define __AXI_BRIDGE_H__
+
+#include <systemc>
+#include <deque>
+#include <string>
+#include <atomic>
+#include <utility>
+#include <sys/types.h>
+
+#include "axi_param.h"
+#include "axi_bus.h"
+
+// Partitioned simulation: the model is cut in two, each part runs in its
+// own process with its own SystemC kernel, on its own core. A bridge in
+// each partition stands for the other one, and the two bridges pass the
+// transactions through ring buffers in shared memory.
+//
+// Time is synchronized conservatively: a transaction sent at t arrives
+// at t + lookahead_ns, so a partition may run lookahead_ns ahead as soon
+// as the other one has reached its time. Every lookahead_ns each bridge
+// publishes its time and waits for the other one; the lookahead is the
+// latency of the link, at least one clock.
+//
+// Partition 0 is the manager side, where the bridge faces request_S and
+// response_S of the bus, and decides when the simulation is done.
+// Partition 1 is the subordinate side, where the bridge stands for the
+// bus and drives the stages and the subordinate.
+
+#define BRIDGE_RING_SLOTS	64
+
+// a transaction in shared memory, plain bytes
+typedef struct
+{
+	uint64_t	stamp_ns;	// when it was sent
+	uint64_t	addr;
+	uint16_t	length;
+	uint8_t		burst;
+	uint8_t		size;
+	bool		is_write;
+	uint8_t		data[AXI_TRANSACTION_LENGTH_MAX * BUS_BYTES];
+	bus_strb_t	strb[AXI_TRANSACTION_LENGTH_MAX];
+} bridge_message_t;
+
+// single producer, single consumer
+typedef struct
+{
+	std::atomic<uint64_t>	head;	// next to read
+	std::atomic<uint64_t>	tail;	// next to write
+	bridge_message_t		slots[BRIDGE_RING_SLOTS];
+} bridge_ring_t;
+
+typedef struct
+{
+	bridge_ring_t			ring[2];		// by sending partition
+	std::atomic<uint64_t>	stamp_ns[2];	// time each partition has reached
+	std::atomic<bool>		is_finished[2];
+	std::atomic<pid_t>		pid[2];			// set around fork()
+} bridge_shared_t;
+
+SC_MODULE(AXI_BRIDGE)
+{
+	sc_fifo_in<axi_trans_handle_t> in;
+	sc_fifo_out<axi_trans_handle_t> out;
+
+	int partition = 0;			// 0 or 1
+	uint64_t lookahead_ns = 1;
+	bridge_shared_t* shared = nullptr;
+
+	// received, by arrival time
+	std::deque<std::pair<uint64_t, axi_trans_handle_t>> q_arrival;
+	sc_event event_arrival;
+	sc_event event_synced;
+
+	// statistics
+	uint64_t count_sent = 0;
+	uint64_t count_received = 0;
+	uint64_t count_sync = 0;
+	uint64_t count_sync_blocked = 0;	// the other partition was behind
+	uint64_t count_ring_full = 0;
+	uint64_t wall_blocked_ns = 0;
+
+	SC_CTOR(AXI_BRIDGE)
+	{
+		SC_THREAD(thread_send);
+		SC_THREAD(thread_sync);
+		SC_THREAD(thread_deliver);
+	}
+
+	// before fork(), shared by both partitions. The caller sets pid[0]
+	// before fork() and pid[1] right after it, in both processes.
+	static bridge_shared_t* create_shared();
+
+	void end_of_elaboration() override;
+
+	void thread_send();
+	void thread_sync();
+	void thread_deliver();
+
+	bool push(const axi_trans_t& trans, uint64_t stamp_ns);
+	void receive();
+	void finish();
+	bool is_peer_exited();
+
+	void report_stats();
+	bool is_idle();
+	void report_outstanding();
+	void log(std::string source, std::string action, std::string detail);
+};
+
+#endif
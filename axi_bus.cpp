@@ -6,16 +6,22 @@
 #include <string>
 #include <iomanip>
 #include <map>
-#include <mutex>
+#include <algorithm>
+#include <memory>
 
 using namespace sc_core;
 using namespace sc_dt;
 
 #include "axi_bus.h"
+#include "axi_checkpoint.h"
+#include "axi_timeline.h"
 
 // when you want to enable debug messages
 // (comment out or) uncomment the following line.
+// make bench defines AXI_BUS_BENCH to time the model without them.
+#ifndef AXI_BUS_BENCH
 #define DEBUG_AXI_BUS
+#endif
 
 // When you (don't) want to see channel signal activity
 // (comment out or) uncomment the following line.
@@ -24,6 +30,76 @@ using namespace sc_dt;
 // When you want to see progress dump
 //#define DEBUG_AXI_BUS_PROGRESS
 
+#ifdef DEBUG_AXI_BUS
+bool AXI_BUS::is_debug = true;
+#else
+bool AXI_BUS::is_debug = false;
+#endif
+
+#ifdef DEBUG_AXI_BUS_CHANNEL
+bool AXI_BUS::is_debug_channel = true;
+#else
+bool AXI_BUS::is_debug_channel = false;
+#endif
+
+#ifdef DEBUG_AXI_BUS_PROGRESS
+bool AXI_BUS::is_debug_progress = true;
+#else
+bool AXI_BUS::is_debug_progress = false;
+#endif
+
+// The pool of the transaction fifos. Entries go back to the free list,
+// never to the heap, so a handle stays valid until the end.
+
+static std::vector<std::unique_ptr<axi_trans_t>> list_trans_pool;
+static std::vector<axi_trans_handle_t> list_trans_free;
+
+axi_trans_handle_t axi_trans_alloc()
+{
+	if (list_trans_free.empty())
+	{
+		list_trans_pool.emplace_back(new axi_trans_t);
+		return list_trans_pool.back().get();
+	}
+	axi_trans_handle_t handle = list_trans_free.back();
+	list_trans_free.pop_back();
+	return handle;
+}
+
+axi_trans_handle_t axi_trans_alloc(const axi_trans_t& trans)
+{
+	axi_trans_handle_t handle = axi_trans_alloc();
+	*handle = trans;
+	return handle;
+}
+
+void axi_trans_free(axi_trans_handle_t handle)
+{
+	list_trans_free.push_back(handle);
+}
+
+size_t axi_trans_count_allocated()
+{
+	return list_trans_pool.size();
+}
+
+size_t axi_trans_count_in_use()
+{
+	return list_trans_pool.size() - list_trans_free.size();
+}
+
+void axi_trans_write(sc_fifo_out<axi_trans_handle_t>& out, const axi_trans_t& trans)
+{
+	out.write(axi_trans_alloc(trans));
+}
+
+void axi_trans_read(sc_fifo_in<axi_trans_handle_t>& in, axi_trans_t& trans)
+{
+	axi_trans_handle_t handle = in.read();
+	trans = *handle;
+	axi_trans_free(handle);
+}
+
 void AXI_BUS::thread_clock()
 {
 	while(true)
@@ -42,6 +118,7 @@ void AXI_BUS::thread_clock()
 
 void AXI_BUS::on_clock()
 {
+	count_clock ++;
 	channel_transaction();
 }
 
@@ -79,35 +156,144 @@ void AXI_BUS::thread_response_S()
 	}
 }
 
+void AXI_BUS::end_of_elaboration()
+{
+	if (id_width < 1 || id_width > 16)
+	{
+		SC_REPORT_FATAL("AXI_BUS", ("Invalid ID width " + std::to_string(id_width)).c_str());
+	}
+
+	q_send_AW.set_capacity(depth_queue_addr);
+	q_recv_AW.set_capacity(depth_queue_addr);
+	q_send_AR.set_capacity(depth_queue_addr);
+	q_recv_AR.set_capacity(depth_queue_addr);
+	q_send_W.set_capacity(depth_queue_data);
+	q_recv_W.set_capacity(depth_queue_data);
+	q_send_R.set_capacity(depth_queue_data);
+	q_recv_R.set_capacity(depth_queue_data);
+	q_send_B.set_capacity(depth_queue_resp);
+	q_recv_B.set_capacity(depth_queue_resp);
+
+	q_id_free.clear();
+	for (uint32_t id = 0; id < ((uint32_t) 1 << id_width); id++)
+	{
+		q_id_free.push_back(id);
+	}
+}
+
+// The queues and map_progress of a drained bus are empty, and VALID is
+// low on every channel, so the state to keep is the ID free list and the
+// state of the READY generators. READY itself is driven again from them
+// at the next clock edge.
+
+void AXI_BUS::save_state(AXI_CHECKPOINT& checkpoint)
+{
+	if (!is_idle())
+	{
+		SC_REPORT_FATAL("AXI_BUS", "Checkpoint with transactions in flight");
+	}
+
+	std::ostringstream oss;
+	oss << random_engine;
+
+	checkpoint.put_tag("BUS:" + std::string(name()));
+	checkpoint.put_uint(id_width);
+	checkpoint.put_uint(q_id_free.size());
+	for (uint32_t id : q_id_free)
+	{
+		checkpoint.put_uint(id);
+	}
+	checkpoint.put_uint(count_clock);
+	checkpoint.put_string(oss.str());
+}
+
+// after elaboration, which fills the ID free list
+
+void AXI_BUS::restore_state(AXI_CHECKPOINT& checkpoint)
+{
+	checkpoint.expect_tag("BUS:" + std::string(name()));
+	if ((int) checkpoint.get_uint() != id_width)
+	{
+		SC_REPORT_FATAL("AXI_BUS", "Checkpoint of another ID width");
+	}
+	q_id_free.clear();
+	uint64_t count = checkpoint.get_uint();
+	for (uint64_t i = 0; i < count; i++)
+	{
+		q_id_free.push_back(checkpoint.get_uint());
+	}
+	count_clock = checkpoint.get_uint();
+	std::istringstream iss(checkpoint.get_string());
+	iss >> random_engine;
+}
+
+// Back to the state after elaboration, between the workloads of a batch.
+// Only called while the simulation is paused with all traffic drained,
+// so no thread holds a queue entry or an ID. The statistics restart too.
+
+void AXI_BUS::soft_reset()
+{
+	q_send_AW.clear();
+	q_recv_AW.clear();
+	q_send_W.clear();
+	q_recv_W.clear();
+	q_send_B.clear();
+	q_recv_B.clear();
+	q_send_AR.clear();
+	q_recv_AR.clear();
+	q_send_R.clear();
+	q_recv_R.clear();
+
+	map_progress.clear();
+	q_id_free.clear();
+	for (uint32_t id = 0; id < ((uint32_t) 1 << id_width); id++)
+	{
+		q_id_free.push_back(id);
+	}
+
+	map_write_buffer.clear();
+	set_write_drain.clear();
+	map_write_drain_word.clear();
+	stamp_write_buffer_ns = 0;
+
+	for (int channel = 0; channel < CHANNEL_COUNT; channel++)
+	{
+		is_transferred[channel] = false;
+		channel_stats[channel] = channel_stats_t();
+	}
+	random_engine.seed(seed);
+
+	count_clock = 0;
+	count_stall_id = 0;
+	count_id_used_max = 0;
+	count_write_buffered = 0;
+	count_word_merged = 0;
+	count_write_drained = 0;
+	count_read_forwarded = 0;
+	count_read_held = 0;
+	id_read_held = -1;
+
+	on_reset();
+}
+
 void AXI_BUS::on_reset()
 {
 	AWVALID.write(0);
 	AWREADY.write(0);
-	AWID.write(0);
-	AWADDR.write(0);
-	AWLEN.write(0);
-
 	WVALID.write(0);
 	WREADY.write(0);
-	WID.write(0);
-	WDATA.write(0);
-	WLAST.write(0);
-
 	BVALID.write(0);
 	BREADY.write(0);
-	BID.write(0);
-
 	ARVALID.write(0);
 	ARREADY.write(0);
-	ARID.write(0);
-	ARADDR.write(0);
-	ARLEN.write(0);
-
 	RVALID.write(0);
 	RREADY.write(0);
-	RID.write(0);
-	RDATA.write(0);
-	RLAST.write(0);
+
+	send_info(CHANNEL_AW, axi_addr_info_t());
+	send_info(CHANNEL_W, axi_data_info_t());
+	send_info(CHANNEL_B, axi_resp_info_t());
+	send_info(CHANNEL_AR, axi_addr_info_t());
+	send_info(CHANNEL_R, axi_data_info_t());
 }
 
 bool AXI_BUS::is_ready(int channel)
@@ -170,116 +356,309 @@ void AXI_BUS::set_ready(int channel, bool value)
 	}
 }
 
-void AXI_BUS::send_info(int channel, axi_bus_info_t& info)
+void AXI_BUS::send_info(int channel, const axi_addr_info_t& info)
 {
+#ifdef AXI_BUS_BUNDLED_SIGNALS
+	switch(channel)
+	{
+		case CHANNEL_AW:	AW = info;	break;
+		case CHANNEL_AR:	AR = info;	break;
+		default:
+			SC_REPORT_FATAL("Not an address channel", std::to_string(channel).c_str());
+	}
+#else
 	switch(channel)
 	{
 		case CHANNEL_AW:	AWID = info.id;
 							AWADDR = info.addr;
 							AWLEN = info.len;
-							break;
-		case CHANNEL_W:		WID = info.id;
-							WDATA = info.data;
-							WLAST = info.is_last;
-							break;
-		case CHANNEL_B:		BID = info.id;
+							AWSIZE = info.size;
+							AWBURST = info.burst;
 							break;
 		case CHANNEL_AR:	ARID = info.id;
 							ARADDR = info.addr;
 							ARLEN = info.len;
+							ARSIZE = info.size;
+							ARBURST = info.burst;
+							break;
+		default:
+			SC_REPORT_FATAL("Not an address channel", std::to_string(channel).c_str());
+			return;
+	}
+#endif
+}
+
+void AXI_BUS::send_info(int channel, const axi_data_info_t& info)
+{
+#ifdef AXI_BUS_BUNDLED_SIGNALS
+	switch(channel)
+	{
+		case CHANNEL_W:		W = info;	break;
+		case CHANNEL_R:		R = info;	break;
+		default:
+			SC_REPORT_FATAL("Not a data channel", std::to_string(channel).c_str());
+	}
+#else
+	switch(channel)
+	{
+		case CHANNEL_W:		WID = info.id;
+							WDATA = info.data;
+							WSTRB = info.strb;
+							WLAST = info.is_last;
 							break;
 		case CHANNEL_R:		RID = info.id;
 							RDATA = info.data;
 							RLAST = info.is_last;
 							break;
 		default:
-			SC_REPORT_FATAL("Unknown channel", std::to_string(channel).c_str());
+			SC_REPORT_FATAL("Not a data channel", std::to_string(channel).c_str());
 			return;
 	}
+#endif
 }
 
-axi_bus_info_t AXI_BUS::create_null_info()
+void AXI_BUS::send_info(int channel, const axi_resp_info_t& info)
 {
-	axi_bus_info_t info;
-
-	info.id = 0;
-	info.addr = 0;
-	info.len = 0;
-	info.data = 0;
-	info.is_last = false;
-	return info;
+#ifdef AXI_BUS_BUNDLED_SIGNALS
+	switch(channel)
+	{
+		case CHANNEL_B:		B = info;	break;
+		default:
+			SC_REPORT_FATAL("Not a response channel", std::to_string(channel).c_str());
+	}
+#else
+	switch(channel)
+	{
+		case CHANNEL_B:		BID = info.id;
+							break;
+		default:
+			SC_REPORT_FATAL("Not a response channel", std::to_string(channel).c_str());
+			return;
+	}
+#endif
 }
 
-axi_bus_info_t AXI_BUS::recv_info(int channel)
+void AXI_BUS::recv_info(int channel, axi_addr_info_t& info)
 {
-	axi_bus_info_t info = create_null_info();
-
+#ifdef AXI_BUS_BUNDLED_SIGNALS
+	switch(channel)
+	{
+		case CHANNEL_AW:	info = AW;	break;
+		case CHANNEL_AR:	info = AR;	break;
+		default:
+			SC_REPORT_FATAL("Not an address channel", std::to_string(channel).c_str());
+	}
+#else
 	switch(channel)
 	{
 		case CHANNEL_AW:	info.id = AWID;
 							info.addr = AWADDR;
 							info.len = AWLEN;
-							break;
-		case CHANNEL_W:		info.id = WID;
-							info.data = WDATA;
-							info.is_last = WLAST;
-							break;
-		case CHANNEL_B:		info.id = BID;
+							info.size = AWSIZE;
+							info.burst = AWBURST;
 							break;
 		case CHANNEL_AR:	info.id = ARID;
 							info.addr = ARADDR;
 							info.len = ARLEN;
+							info.size = ARSIZE;
+							info.burst = ARBURST;
+							break;
+		default:
+			SC_REPORT_FATAL("Not an address channel", std::to_string(channel).c_str());
+	}
+#endif
+}
+
+void AXI_BUS::recv_info(int channel, axi_data_info_t& info)
+{
+#ifdef AXI_BUS_BUNDLED_SIGNALS
+	switch(channel)
+	{
+		case CHANNEL_W:		info = W;	break;
+		case CHANNEL_R:		info = R;
+							info.strb = 0;
+							break;
+		default:
+			SC_REPORT_FATAL("Not a data channel", std::to_string(channel).c_str());
+	}
+#else
+	switch(channel)
+	{
+		case CHANNEL_W:		info.id = WID;
+							info.data = WDATA;
+							info.strb = WSTRB;
+							info.is_last = WLAST;
 							break;
 		case CHANNEL_R:		info.id = RID;
 							info.data = RDATA;
+							info.strb = 0;
 							info.is_last = RLAST;
 							break;
 		default:
-			SC_REPORT_FATAL("Unknown channel", std::to_string(channel).c_str());
+			SC_REPORT_FATAL("Not a data channel", std::to_string(channel).c_str());
 	}
-	return (info);
+#endif
 }
 
-void AXI_BUS::channel_receiver(int channel, std::queue<axi_bus_info_t>& q)
+void AXI_BUS::recv_info(int channel, axi_resp_info_t& info)
 {
-	std::string log_action = CHANNEL_UNKNOWN;
-	std::string log_detail = "";
+#ifdef AXI_BUS_BUNDLED_SIGNALS
+	switch(channel)
+	{
+		case CHANNEL_B:		info = B;	break;
+		default:
+			SC_REPORT_FATAL("Not a response channel", std::to_string(channel).c_str());
+	}
+#else
+	switch(channel)
+	{
+		case CHANNEL_B:		info.id = BID;
+							break;
+		default:
+			SC_REPORT_FATAL("Not a response channel", std::to_string(channel).c_str());
+	}
+#endif
+}
 
-	mutex_q.lock();
-	
-	if (is_ready(channel) == 0)
+// The request channels are received on the subordinate side.
+// When the subordinate does not take requests any more,
+// the request fifo is full and we stop accepting new ones.
+
+bool AXI_BUS::is_downstream_full(int channel)
+{
+	switch (channel)
 	{
-		set_ready(channel, true);
-		log_action = CHANNEL_NOT_READY;
+		case CHANNEL_AW:
+		case CHANNEL_W:
+		case CHANNEL_AR:	return (request_S->num_free() == 0);
+		default:			return false;
+	}
+}
+
+void AXI_BUS::set_ready_policy(int channel, const ready_policy_t& policy)
+{
+	ready_policy[channel] = policy;
+}
+
+void AXI_BUS::set_seed(uint32_t seed)
+{
+	this->seed = seed;
+	random_engine.seed(seed);
+}
+
+// The bus is a process of the timeline, with one track per channel.
+// The tracks of the IDs are named when first used.
+
+void AXI_BUS::set_timeline(AXI_TIMELINE* timeline)
+{
+	const int channels[] = {CHANNEL_AW, CHANNEL_W, CHANNEL_B, CHANNEL_AR, CHANNEL_R};
+
+	this->timeline = timeline;
+	timeline_pid = timeline->add_process(name());
+	for (int channel : channels)
+	{
+		timeline->name_track(timeline_pid, channel, get_channel_name(channel));
+	}
+}
+
+// READY for the next clock edge, by the generator of the channel.
+// occupancy is the number of entries in q_recv of the channel.
+
+bool AXI_BUS::is_ready_by_policy(int channel, size_t occupancy)
+{
+	const ready_policy_t& policy = ready_policy[channel];
+
+	switch (policy.mode)
+	{
+		case READY_ALWAYS:
+			return true;
+		case READY_RANDOM:
+		{
+			std::bernoulli_distribution dist(policy.probability);
+			return dist(random_engine);
+		}
+		case READY_PERIODIC:
+			if (policy.period == 0)
+			{
+				return true;
+			}
+			return ((count_clock % policy.period) < policy.duty);
+		case READY_CREDIT:
+			// one credit for each free slot
+			return (occupancy < policy.credits);
+		default:
+			SC_REPORT_FATAL("Unknown READY policy", std::to_string(policy.mode).c_str());
+			return true;
 	}
-	else if (is_valid(channel))	// ready and valid
+}
+
+template <typename T>
+void AXI_BUS::channel_receiver(int channel, AXI_RING<T>& q)
+{
+	std::string log_action = CHANNEL_UNKNOWN;
+	std::string log_detail = "";
+	channel_stats_t& stats = channel_stats[channel];
+
+	// Signals still have the values of the clock edge.
+	is_transferred[channel] = is_ready(channel) && is_valid(channel);
+
+	if (is_transferred[channel])
 	{
-		axi_bus_info_t info = recv_info(channel);
+		T info = {};
+		recv_info(channel, info);
 		q.push(info);
 		event_something_to_send.notify(SC_ZERO_TIME);
+		if (timeline)
+		{
+			timeline->complete(timeline_pid, channel, get_channel_name(channel), 1, bus_info_to_string(info));
+		}
+		stats.count_transfer ++;
+		stats.max_occupancy = std::max(stats.max_occupancy, q.size());
 		log_action = CHANNEL_RECV;
 		log_detail = bus_info_to_string(info);
 	}
-	else	// ready but not valid
+	else if (is_ready(channel))	// ready but not valid
 	{
 		log_action = CHANNEL_WAITV;
 	}
+	else
+	{
+		if (is_valid(channel))
+		{
+			stats.cycles_stall ++;
+		}
+		stats.cycles_not_ready ++;
+		log_action = CHANNEL_NOT_READY;
+	}
+
+	if (is_downstream_full(channel) || q.full())
+	{
+		if (q.full())
+		{
+			stats.cycles_full ++;
+		}
+		set_ready(channel, false);
+		log_action = CHANNEL_FULL;
+	}
+	else
+	{
+		set_ready(channel, is_ready_by_policy(channel, q.size()));
+	}
 
 	log(channel, log_action, log_detail);
-	mutex_q.unlock();
 }
 
-void AXI_BUS::channel_sender(int channel, std::queue<axi_bus_info_t>& q)
+template <typename T>
+void AXI_BUS::channel_sender(int channel, AXI_RING<T>& q)
 {
 	std::string log_action = CHANNEL_UNKNOWN;
 	std::string log_detail = "";
-	axi_bus_info_t info;
+	T info = {};
 
-	mutex_q.lock();
 
 	if (!q.empty())
 	{
-		if (is_ready(channel) == 0 && is_valid(channel) == 1)
+		if (is_valid(channel) && !is_transferred[channel])
 		{
 			// The receiver did not take current data yet.
 			// We have to wait until the receiver is ready
@@ -301,6 +680,7 @@ void AXI_BUS::channel_sender(int channel, std::queue<axi_bus_info_t>& q)
 			send_info(channel, info);
 			set_valid(channel, true);
 			q.pop();
+			event_queue_space.notify(SC_ZERO_TIME);
 
 			log_action = CHANNEL_SEND;
 			log_detail += ", " + bus_info_to_string(info);
@@ -308,7 +688,7 @@ void AXI_BUS::channel_sender(int channel, std::queue<axi_bus_info_t>& q)
 	}
 	else	// Q is empty
 	{
-		if (is_ready(channel))
+		if (is_transferred[channel] || !is_valid(channel))
 		{
 			if (is_valid(channel))
 			{
@@ -317,7 +697,7 @@ void AXI_BUS::channel_sender(int channel, std::queue<axi_bus_info_t>& q)
 				set_valid(channel, false);
 
 				// AXI spec recommends to set zero when not in use
-				info = create_null_info();
+				info = {};
 				send_info(channel, info);
 				log_action = CHANNEL_IDLE;
 			}
@@ -328,40 +708,33 @@ void AXI_BUS::channel_sender(int channel, std::queue<axi_bus_info_t>& q)
 			}
 
 		}
-		else	// Q is empty and not ready
+		else	// Q is empty and data not taken yet
 		{
-			if (is_valid(channel))
-			{
-				log_action = CHANNEL_WAITR;
-			}
-			else
-			{
-				log_action = CHANNEL_IDLE;
-			}
+			log_action = CHANNEL_WAITR;
 		}
 	}
 
 	log(channel, log_action, log_detail);
-	mutex_q.unlock();
 }
 
 void AXI_BUS::log(int channel, std::string action, std::string detail)
 {
-#ifdef DEBUG_AXI_BUS_CHANNEL
-	log(get_channel_name(channel), action, detail);
-#endif
+	if (is_debug_channel)
+	{
+		log(get_channel_name(channel), action, detail);
+	}
 	return;
 }
 
 void AXI_BUS::log(std::string source, std::string action, std::string detail)
 {
-
-#ifdef DEBUG_AXI_BUS
-	std::string out;
-	out = sc_time_stamp().to_string() + ":" + source
-		+ ":" + action + ":" + detail;
-	std::cout << out << std::endl;
-#endif
+	if (is_debug)
+	{
+		std::string out;
+		out = sc_time_stamp().to_string() + ":" + source
+			+ ":" + action + ":" + detail;
+		std::cout << out << std::endl;
+	}
 
 	return;
 }
@@ -409,67 +782,72 @@ void AXI_BUS::channel_transaction()
 
 void AXI_BUS::transaction_request_M()
 {
-	axi_trans_t trans;
-
-	// blocking read
-	trans = request_M.read();
+	// blocking read, the beats are copied out of the pool entry
+	axi_trans_handle_t handle = request_M.read();
+	const axi_trans_t& trans = *handle;
 	log(__FUNCTION__, "GOT_REQUEST", transaction_to_string(trans));
 
-	uint32_t id = generate_transaction_id();
-	axi_bus_info_t info = create_null_info();
+	uint32_t id = allocate_transaction_id();
+	axi_addr_info_t info = {};
 	info.id = id;
 	info.addr = trans.addr;
 	info.len = trans.length - 1;
+	info.burst = trans.burst;
+	info.size = trans.size;
 
-
-	mutex_q.lock();
+	if (timeline)
+	{
+		int tid = TIMELINE_TID_ID + id;
+		timeline->name_track(timeline_pid, tid, "ID " + std::to_string(id));
+		timeline->begin(timeline_pid, tid, trans.is_write ? "WRITE" : "READ", bus_info_to_string(info));
+	}
 
 	if (trans.is_write)
 	{
-		q_send_AW.push(info);
+		queue_push(q_send_AW, info);
 
-		info.is_last = false;
+		axi_data_info_t info_w = {};
+		info_w.id = id;
 		for (int i = 0; i < trans.length; i++)
 		{
-			if (i == info.len)
-			{
-				info.is_last = true;
-			}
-			info.data = trans.data[i];
-			q_send_W.push(info);
+			info_w.is_last = (i == info.len);
+			info_w.data = trans.data[i];
+			info_w.strb = trans.strb[i];
+			queue_push(q_send_W, info_w);
 		}
 	}
 	else
 	{
 		progress_create(info, trans.is_write);
-		q_send_AR.push(info);
+		queue_push(q_send_AR, info);
 	}
-
-	mutex_q.unlock();
+	axi_trans_free(handle);
 }
 
 void AXI_BUS::transaction_response_S()
 {
-	axi_trans_t trans;
-
-	// blocking read
-	trans = response_S.read();
+	// blocking read, the beats are copied out of the pool entry
+	axi_trans_handle_t handle = response_S.read();
+	const axi_trans_t& trans = *handle;
 	log(__FUNCTION__, "GOT_RESPONSE", transaction_to_string(trans));
 
-	mutex_q.lock();
+	if (write_buffer_absorb(trans))
+	{
+		// response to a drained write, B was sent already
+		axi_trans_free(handle);
+		return;
+	}
 
 	uint32_t id;
-	tuple_progress_t progress;
-	axi_trans_t trans_in_progress;
 	bool found = false;
 
-	for (auto iter: map_progress)
+	for (const auto& iter: map_progress)
 	{
 		id = iter.first;
-		progress = iter.second;
-		trans_in_progress = std::get<0>(progress);
+		const axi_trans_t& trans_in_progress = std::get<0>(iter.second);
 
-		if (trans_in_progress.addr != trans.addr)
+		if (trans_in_progress.addr != trans.addr
+			|| trans_in_progress.is_write != trans.is_write)
 		{
 			continue;
 		}
@@ -483,37 +861,35 @@ void AXI_BUS::transaction_response_S()
 		log(__FUNCTION__, "Response not in progress",transaction_to_string(trans));
 		progress_dump();
 		SC_REPORT_FATAL("Response, not in progress", transaction_to_string(trans).c_str());
-
-		mutex_q.unlock();
 		return;
 	}
 
-	axi_bus_info_t info = create_null_info();
-	info.id = id;
-	info.addr = trans.addr;
-	info.len = trans.length - 1;
+	if (timeline)
+	{
+		timeline->end(timeline_pid, TIMELINE_TID_ID + id);
+	}
+
 	if (trans.is_write)
 	{
-		q_send_B.push(info);
+		axi_resp_info_t info = {};
+		info.id = id;
+		queue_push(q_send_B, info);
 	}
 	else
 	{
-		info.is_last = false;
+		axi_data_info_t info = {};
+		info.id = id;
 		for (int i = 0; i < trans.length; i++)
 		{
-			if (i == info.len)
-			{
-				info.is_last = true;
-			}
+			info.is_last = (i == trans.length - 1);
 			info.data = trans.data[i];
-			q_send_R.push(info);
+			queue_push(q_send_R, info);
 		}
 	}
-
-	mutex_q.unlock();
+	axi_trans_free(handle);
 }
 
-bool AXI_BUS::progress_create(axi_bus_info_t& info, bool is_write)
+bool AXI_BUS::progress_create(const axi_addr_info_t& info, bool is_write)
 {
 	std::string log_detail;
 
@@ -530,6 +906,8 @@ bool AXI_BUS::progress_create(axi_bus_info_t& info, bool is_write)
 
 	trans.addr = info.addr;
 	trans.length = info.len + 1;
+	trans.burst = info.burst;
+	trans.size = info.size;
 	trans.is_write = is_write;
 	map_progress[info.id] = std::make_tuple(trans, 0);
 	log_detail = "outstanding=" + std::to_string(map_progress.size());
@@ -539,24 +917,30 @@ bool AXI_BUS::progress_create(axi_bus_info_t& info, bool is_write)
 	return true;
 }
 
-void AXI_BUS::progress_delete(axi_bus_info_t& info)
+void AXI_BUS::progress_delete(uint32_t id)
 {
 	std::string log_detail;
 
-	auto iter = map_progress.find(info.id);
+	auto iter = map_progress.find(id);
 	if (iter == map_progress.end())
 	{
 		// No such ID
-		log(__FUNCTION__, "NO ID", bus_info_to_string(info));
+		log_detail = "id=" + std::to_string(id);
+		log(__FUNCTION__, "NO ID", log_detail);
 		progress_dump();
-		SC_REPORT_FATAL("NO ID", bus_info_to_string(info).c_str());
+		SC_REPORT_FATAL("NO ID", log_detail.c_str());
 		return;
 	}
 
 	map_progress.erase(iter);
+	release_transaction_id(id);
+	if (timeline)
+	{
+		timeline->end(timeline_pid, TIMELINE_TID_ID + id);
+	}
 
 	log_detail = "outstanding=" + std::to_string(map_progress.size());
-	log_detail += ", id=" + std::to_string(info.id);
+	log_detail += ", id=" + std::to_string(id);
 	log(__FUNCTION__, "DELETE PROGRESS", log_detail);
 	progress_dump();
 
@@ -566,11 +950,11 @@ void AXI_BUS::progress_delete(axi_bus_info_t& info)
 // returns true when 100% progress is made.
 // you have to pop the q manually when this returns true.
 
-bool AXI_BUS::progress_update(std::queue<axi_bus_info_t>& q)
+bool AXI_BUS::progress_update(AXI_RING<axi_data_info_t>& q)
 {
 	std::string log_detail;
 
-	axi_bus_info_t info;
+	axi_data_info_t info;
 	
 	if (q.empty())
 	{
@@ -588,12 +972,13 @@ bool AXI_BUS::progress_update(std::queue<axi_bus_info_t>& q)
 	}
 	auto& progress = iter->second;
 	auto& trans_in_progress = std::get<0>(progress);
-	int8_t count_done = std::get<1>(progress);
+	int count_done = std::get<1>(progress);
 
 	if (count_done < trans_in_progress.length)
 	{
 		// be careful to update original data
 		trans_in_progress.data[count_done] = info.data;
+		trans_in_progress.strb[count_done] = info.strb;
 		count_done ++;
 		std::get<1>(progress) = count_done;
 	}
@@ -646,18 +1031,18 @@ bool AXI_BUS::progress_update(std::queue<axi_bus_info_t>& q)
 	return false;
 }
 
-std::string AXI_BUS::transaction_send_info(sc_fifo_out<axi_trans_t>& fifo_out, axi_bus_info_t& info)
+std::string AXI_BUS::transaction_send_info(sc_fifo_out<axi_trans_handle_t>& fifo_out, uint32_t id)
 {
 	std::string log_detail;
 
 	// This function does not lock the queue.
 	// You must lock the queue before calling this function if needed.
 
-	auto iter = map_progress.find(info.id);
+	auto iter = map_progress.find(id);
 	if (iter == map_progress.end())
 	{
 		// Nothing in progress for that id
-		log_detail += ", " + bus_info_to_string(info);
+		log_detail += "id=" + std::to_string(id);
 		log(__FUNCTION__, "NO ID in progress", log_detail);
 		progress_dump();
 		SC_REPORT_FATAL("NOID", "q_recv_X");
@@ -665,104 +1050,333 @@ std::string AXI_BUS::transaction_send_info(sc_fifo_out<axi_trans_t>& fifo_out, a
 
 	auto& progress = iter->second;
 	auto& trans_in_progress = std::get<0>(progress);
-	fifo_out.write(trans_in_progress);
+	axi_trans_write(fifo_out, trans_in_progress);
 	log_detail = transaction_to_string(trans_in_progress);
 	return log_detail;
 }
 
+// Push into a channel queue. While the queue is full, waits for a free slot.
+// The wait() is a scheduling point, see the invariants in axi_bus.h.
+
+template <typename T>
+void AXI_BUS::queue_push(AXI_RING<T>& q, const T& info)
+{
+	while (q.full())
+	{
+		q.count_full ++;
+		wait(event_queue_space);
+	}
+	q.push(info);
+}
+
 void AXI_BUS::transaction_response_M()
 {
 	std::string log_detail;
-	mutex_q.lock();
 
 	// write transaction
-	if (q_recv_B.empty())
+	if (!q_recv_B.empty())
 	{
-		mutex_q.unlock();
-	}
-	else
-	{
-		axi_bus_info_t info = q_recv_B.front();
+		axi_resp_info_t info = q_recv_B.front();
 		q_recv_B.pop();
-		log_detail = transaction_send_info(response_M, info);
+		log_detail = transaction_send_info(response_M, info.id);
 		log(__FUNCTION__, "SENT RESPONSE", log_detail);
-		progress_delete(info);
-		mutex_q.unlock();
+		progress_delete(info.id);
 	}
 
 	// read transaction
-	mutex_q.lock();
 	bool is_completed = progress_update(q_recv_R);
-	if (!is_completed)
-	{
-		mutex_q.unlock();
-	}
-	else
+	if (is_completed)
 	{
-		axi_bus_info_t info = q_recv_R.front();
+		axi_data_info_t info = q_recv_R.front();
 		q_recv_R.pop();
-		mutex_q.unlock();
-	
-		log_detail = transaction_send_info(response_M, info);
+
+		log_detail = transaction_send_info(response_M, info.id);
 		log(__FUNCTION__, "SENT RESPONSE", log_detail);
-		mutex_q.lock();
-		progress_delete(info);
-		mutex_q.unlock();
+		progress_delete(info.id);
 	}
-
 }
 
 void AXI_BUS::transaction_request_S()
 {
-
-	mutex_q.lock();
-
 	if (!q_recv_AW.empty())
 	{
 		progress_create(q_recv_AW.front(), true);
 		q_recv_AW.pop();
 	}
 
-	mutex_q.unlock();
-	mutex_q.lock();
+	// idle write buffer
+	uint64_t stamp_now_ns = sc_time_stamp().value() / 1000; // ps to ns convert.
+	if (!map_write_buffer.empty()
+		&& stamp_now_ns >= stamp_write_buffer_ns + write_buffer_timeout_ns)
+	{
+		write_buffer_drain();
+	}
 
-	bool is_completed = progress_update(q_recv_W);
-	if (is_completed)
+	// W may come before its AW, then it waits in q_recv_W for the AW
+	bool is_completed = false;
+	if (!q_recv_W.empty() && map_progress.count(q_recv_W.front().id) > 0)
 	{
-		axi_bus_info_t info = q_recv_W.front();
-		q_recv_W.pop();
-		mutex_q.unlock();
-		transaction_send_info(request_S, info);
+		is_completed = progress_update(q_recv_W);
 	}
-	else
+	else if (!q_recv_W.empty())
 	{
-		mutex_q.unlock();
+		log(__FUNCTION__, "W BEFORE AW", bus_info_to_string(q_recv_W.front()));
 	}
+	if (is_completed && is_write_buffered)
+	{
+		axi_data_info_t info = q_recv_W.front();
+		q_recv_W.pop();
+
+		// early response, the write is done as far as the manager knows
+		write_buffer_insert(std::get<0>(map_progress[info.id]));
+		axi_resp_info_t info_b = {};
+		info_b.id = info.id;
+		queue_push(q_send_B, info_b);
+		log(__FUNCTION__, "EARLY RESPONSE", bus_info_to_string(info_b));
 
-	mutex_q.lock();
+		if (map_write_buffer.size() >= depth_write_buffer)
+		{
+			write_buffer_drain();
+		}
+	}
+	else if (is_completed)
+	{
+		axi_data_info_t info = q_recv_W.front();
+		q_recv_W.pop();
+		if (timeline)
+		{
+			timeline->begin(timeline_pid, TIMELINE_TID_ID + info.id, "SUBORDINATE");
+		}
+		transaction_send_info(request_S, info.id);
+	}
 
 	if (!q_recv_AR.empty())
 	{
-		axi_bus_info_t info = q_recv_AR.front();
+		axi_addr_info_t info = q_recv_AR.front();
+
+		if (write_buffer_forward(info))
+		{
+			id_read_held = -1;
+			q_recv_AR.pop();
+			return;
+		}
+		if (write_buffer_overlaps(info))
+		{
+			// the read must see the buffered writes, counted once while it waits
+			if (id_read_held != (int64_t) info.id)
+			{
+				id_read_held = info.id;
+				count_read_held ++;
+				log(__FUNCTION__, "READ HELD", bus_info_to_string(info));
+			}
+			if (!map_write_buffer.empty())
+			{
+				write_buffer_drain();
+			}
+			return;
+		}
+
+		id_read_held = -1;
 		q_recv_AR.pop();
-		mutex_q.unlock();
-		transaction_send_info(request_S, info);
+		if (timeline)
+		{
+			timeline->begin(timeline_pid, TIMELINE_TID_ID + info.id, "SUBORDINATE");
+		}
+		transaction_send_info(request_S, info.id);
+	}
+}
+
+void AXI_BUS::write_buffer_insert(const axi_trans_t& trans)
+{
+	for (int i = 0; i < trans.length; i++)
+	{
+		uint64_t addr_beat = axi_beat_address(trans.addr, trans.burst, trans.size, trans.length, i);
+		uint64_t addr = axi_word_address(addr_beat);
+		bus_strb_t strb = trans.strb[i] & axi_beat_strobe(addr_beat, trans.size);
+
+		auto iter = map_write_buffer.find(addr);
+		if (iter == map_write_buffer.end())
+		{
+			map_write_buffer[addr] = write_buffer_word_t{trans.data[i], strb};
+		}
+		else
+		{
+			// overlapping write, the later bytes win
+			count_word_merged ++;
+			iter->second.data = bus_data_merge(iter->second.data, trans.data[i], strb);
+			iter->second.strb |= strb;
+		}
 	}
 
-	mutex_q.unlock();
+	count_write_buffered ++;
+	stamp_write_buffer_ns = sc_time_stamp().value() / 1000; // ps to ns convert.
+	event_something_to_send.notify(write_buffer_timeout_ns, SC_NS);
 }
 
-uint32_t AXI_BUS::generate_transaction_id()
+// Send everything in the write buffer to the subordinate,
+// contiguous words as one INCR burst.
+
+void AXI_BUS::write_buffer_drain()
+{
+	const uint64_t BOUNDARY_BYTES = 4096;
+	std::vector<axi_trans_t> bursts;
+	axi_trans_t trans;
+
+	trans.length = 0;
+	for (auto& iter : map_write_buffer)
+	{
+		uint64_t addr = iter.first;
+		bool is_contiguous = (trans.length > 0)
+			&& (addr == trans.addr + (uint64_t) trans.length * BUS_BYTES)
+			&& (trans.length < AXI_TRANSACTION_LENGTH_MAX)
+			&& (addr % BOUNDARY_BYTES != 0);
+
+		if (!is_contiguous)
+		{
+			if (trans.length > 0)
+			{
+				bursts.push_back(trans);
+			}
+			trans.addr = addr;
+			trans.length = 0;
+			trans.burst = AXI_BURST_INCR;
+			trans.size = AXI_SIZE_FULL;
+			trans.is_write = true;
+		}
+		trans.data[trans.length] = iter.second.data;
+		trans.strb[trans.length] = iter.second.strb;
+		trans.length ++;
+		map_write_drain_word[addr] ++;
+	}
+	if (trans.length > 0)
+	{
+		bursts.push_back(trans);
+	}
+	map_write_buffer.clear();
+
+	for (axi_trans_t& burst : bursts)
+	{
+		set_write_drain.insert(burst.addr);
+		count_write_drained ++;
+		log(__FUNCTION__, "DRAIN", transaction_to_string(burst));
+		axi_trans_write(request_S, burst);
+	}
+}
+
+bool AXI_BUS::write_buffer_overlaps(const axi_addr_info_t& info)
+{
+	if (map_write_buffer.empty() && map_write_drain_word.empty())
+	{
+		return false;
+	}
+
+	int length = info.len + 1;
+	for (int i = 0; i < length; i++)
+	{
+		uint64_t addr = axi_word_address(axi_beat_address(info.addr, info.burst, info.size, length, i));
+		if (map_write_buffer.count(addr) || map_write_drain_word.count(addr))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+// Serve the read from the write buffer when it holds all the bytes,
+// and q_send_R has room for the whole burst.
+
+bool AXI_BUS::write_buffer_forward(const axi_addr_info_t& info)
+{
+	int length = info.len + 1;
+
+	if (map_write_buffer.empty() || q_send_R.free() < (size_t) length)
+	{
+		return false;
+	}
+
+	for (int i = 0; i < length; i++)
+	{
+		uint64_t addr_beat = axi_beat_address(info.addr, info.burst, info.size, length, i);
+		bus_strb_t strb = axi_beat_strobe(addr_beat, info.size);
+		auto iter = map_write_buffer.find(axi_word_address(addr_beat));
+		if (iter == map_write_buffer.end() || (iter->second.strb & strb) != strb)
+		{
+			return false;
+		}
+	}
+
+	axi_data_info_t info_r = {};
+	info_r.id = info.id;
+	for (int i = 0; i < length; i++)
+	{
+		uint64_t addr_beat = axi_beat_address(info.addr, info.burst, info.size, length, i);
+		info_r.is_last = (i == info.len);
+		info_r.data = map_write_buffer[axi_word_address(addr_beat)].data;
+		q_send_R.push(info_r);
+	}
+
+	count_read_forwarded ++;
+	log(__FUNCTION__, "READ FORWARDED", bus_info_to_string(info));
+	return true;
+}
+
+// Take the response of a drained write. Returns false for other responses.
+
+bool AXI_BUS::write_buffer_absorb(const axi_trans_t& trans)
+{
+	if (!trans.is_write)
+	{
+		return false;
+	}
+
+	auto iter = set_write_drain.find(trans.addr);
+	if (iter == set_write_drain.end())
+	{
+		return false;
+	}
+	set_write_drain.erase(iter);
+
+	for (int i = 0; i < trans.length; i++)
+	{
+		uint64_t addr = trans.addr + (uint64_t) i * BUS_BYTES;
+		auto iter_word = map_write_drain_word.find(addr);
+		if (iter_word != map_write_drain_word.end() && --iter_word->second == 0)
+		{
+			map_write_drain_word.erase(iter_word);
+		}
+	}
+
+	// held reads may go now
+	event_something_to_send.notify(SC_ZERO_TIME);
+	log(__FUNCTION__, "DRAINED", transaction_to_string(trans));
+	return true;
+}
+
+// Takes the least recently freed ID, waits when all IDs are in use.
+
+uint32_t AXI_BUS::allocate_transaction_id()
 {
-	static uint32_t id = 0;
-	id ++;
-	if (id == 0)
+	size_t count_id = (size_t) 1 << id_width;
+
+	while (q_id_free.empty())
 	{
-		id ++;
+		count_stall_id ++;
+		log(__FUNCTION__, "NO FREE ID", "in use=" + std::to_string(count_id));
+		wait(event_id_free);
 	}
+
+	uint32_t id = q_id_free.front();
+	q_id_free.pop_front();
+	count_id_used_max = std::max(count_id_used_max, count_id - q_id_free.size());
 	return id;
 }
 
+void AXI_BUS::release_transaction_id(uint32_t id)
+{
+	q_id_free.push_back(id);
+	event_id_free.notify(SC_ZERO_TIME);
+}
+
 void AXI_BUS::wait_enough_delta_cycles()
 {
 	const int ENOUGH_DELTA_CYCLES = 10;
@@ -772,22 +1386,40 @@ void AXI_BUS::wait_enough_delta_cycles()
 	}
 }
 
-std::string AXI_BUS::bus_info_to_string(const axi_bus_info_t& info)
+std::string AXI_BUS::bus_info_to_string(const axi_addr_info_t& info)
 {
 	std::string s;
 	s = "id=" + std::to_string(info.id)
 		+ ", addr=" + address_to_hex_string(info.addr)
 		+ ", len=" + std::to_string(info.len)
-		+ ", data=" + bus_data_to_hex_string(info.data);
+		+ ", burst=" + axi_burst_to_string(info.burst)
+		+ ", size=" + std::to_string(info.size);
 	return s;
 }
 
+std::string AXI_BUS::bus_info_to_string(const axi_data_info_t& info)
+{
+	std::string s;
+	s = "id=" + std::to_string(info.id)
+		+ ", data=" + bus_data_to_hex_string(info.data)
+		+ ", strb=" + bus_strb_to_hex_string(info.strb)
+		+ ", last=" + std::to_string(info.is_last);
+	return s;
+}
+
+std::string AXI_BUS::bus_info_to_string(const axi_resp_info_t& info)
+{
+	return "id=" + std::to_string(info.id);
+}
+
 std::string AXI_BUS::transaction_to_string(const axi_trans_t& trans)
 {
 	std::string s;
 	bool is_first = true;
 	s = "addr=" + address_to_hex_string(trans.addr)
 		+ ", length=" + std::to_string(trans.length)
+		+ ", burst=" + axi_burst_to_string(trans.burst)
+		+ ", size=" + std::to_string(trans.size)
 		+ ", wr=" + std::to_string(trans.is_write)
 		+ ", data=";
 	for (int i = 0; i < trans.length; i++)
@@ -808,7 +1440,7 @@ std::string AXI_BUS::transaction_to_string(const axi_trans_t& trans)
 std::string AXI_BUS::progress_to_string(const tuple_progress_t& progress)
 {
 	axi_trans_t trans;
-	uint8_t count;
+	uint16_t count;
 	trans = std::get<0>(progress);
 	count = std::get<1>(progress);
 	std::string s;
@@ -818,9 +1450,12 @@ std::string AXI_BUS::progress_to_string(const tuple_progress_t& progress)
 
 void AXI_BUS::progress_dump()
 {
+	if (!is_debug_progress)
+	{
+		return;
+	}
 
-#ifdef DEBUG_AXI_BUS_PROGRESS
-	//typedef std::tuple<axi_trans_t, int8_t>
+	//typedef std::tuple<axi_trans_t, uint16_t>
 	tuple_progress_t progress;
 	uint32_t id;
 	std::string out;
@@ -836,7 +1471,84 @@ void AXI_BUS::progress_dump()
 	out += "----------------------------------------------- progress dump end\n";
 
 	std::cout << out;
-#endif
+}
 
-	return;
+// Nothing in the channel queues, in the write buffer or in progress,
+// and every ID is free.
+
+bool AXI_BUS::is_idle()
+{
+	return q_send_AW.empty() && q_send_W.empty() && q_send_B.empty()
+		&& q_send_AR.empty() && q_send_R.empty()
+		&& q_recv_AW.empty() && q_recv_W.empty() && q_recv_B.empty()
+		&& q_recv_AR.empty() && q_recv_R.empty()
+		&& map_progress.empty() && q_id_free.size() == ((size_t) 1 << id_width)
+		&& map_write_buffer.empty() && set_write_drain.empty()
+		&& request_M->num_available() == 0 && response_S->num_available() == 0;
 }
+
+void AXI_BUS::report_outstanding()
+{
+	std::cout << "BUS " << name() << ": in_progress=" << map_progress.size()
+		<< ", ids_in_use=" << (((size_t) 1 << id_width) - q_id_free.size())
+		<< ", write_buffer=" << map_write_buffer.size()
+		<< ", draining=" << set_write_drain.size() << std::endl;
+	std::cout << "BUS " << name() << ":   queued beats send/recv"
+		<< " AW=" << q_send_AW.size() << "/" << q_recv_AW.size()
+		<< ", W=" << q_send_W.size() << "/" << q_recv_W.size()
+		<< ", B=" << q_send_B.size() << "/" << q_recv_B.size()
+		<< ", AR=" << q_send_AR.size() << "/" << q_recv_AR.size()
+		<< ", R=" << q_send_R.size() << "/" << q_recv_R.size() << std::endl;
+	for (const auto& iter : map_progress)
+	{
+		std::cout << "BUS " << name() << ":   id=" << iter.first
+			<< ", " << progress_to_string(iter.second) << std::endl;
+	}
+}
+
+template <typename T>
+void AXI_BUS::report_queue(int channel, const AXI_RING<T>& q_send, const AXI_RING<T>& q_recv)
+{
+	const channel_stats_t& stats = channel_stats[channel];
+
+	std::cout << "BUS " << name() << ":" << get_channel_name(channel)
+		<< ": transfers=" << stats.count_transfer
+		<< ", stall_cycles=" << stats.cycles_stall
+		<< ", not_ready_cycles=" << stats.cycles_not_ready
+		<< ", max_occupancy=" << stats.max_occupancy
+		<< ", throughput=" << (count_clock ? (double) stats.count_transfer / count_clock : 0)
+		<< " beats/cycle" << std::endl;
+	std::cout << "BUS " << name() << ":" << get_channel_name(channel)
+		<< ": depth=" << q_send.capacity()
+		<< ", send_max=" << q_send.max_occupancy
+		<< ", send_full_stalls=" << q_send.count_full
+		<< ", recv_max=" << q_recv.max_occupancy
+		<< ", recv_full_cycles=" << stats.cycles_full << std::endl;
+}
+
+void AXI_BUS::report_stats()
+{
+	report_queue(CHANNEL_AW, q_send_AW, q_recv_AW);
+	report_queue(CHANNEL_W, q_send_W, q_recv_W);
+	report_queue(CHANNEL_B, q_send_B, q_recv_B);
+	report_queue(CHANNEL_AR, q_send_AR, q_recv_AR);
+	report_queue(CHANNEL_R, q_send_R, q_recv_R);
+
+	std::cout << "BUS " << name() << ": id_width=" << id_width
+		<< ", max_ids_in_use=" << count_id_used_max
+		<< ", stall_no_id=" << count_stall_id << std::endl;
+
+	if (is_write_buffered)
+	{
+		std::cout << "BUS " << name() << ": buffered_writes=" << count_write_buffered
+			<< ", merged_words=" << count_word_merged
+			<< ", drained_bursts=" << count_write_drained
+			<< ", forwarded_reads=" << count_read_forwarded
+			<< ", held_reads=" << count_read_held << std::endl;
+	}
+}
+
+// used by the unit tests and micro benchmarks in test/ as well
+template void AXI_BUS::channel_sender(int channel, AXI_RING<axi_addr_info_t>& q);
+template void AXI_BUS::channel_sender(int channel, AXI_RING<axi_data_info_t>& q);
+template void AXI_BUS::channel_sender(int channel, AXI_RING<axi_resp_info_t>& q);
@@ -5,19 +5,31 @@
 #include <iostream>
 #include <fstream>
 #include <queue>
+#include <deque>
 #include <sstream>
 #include <vector>
 #include <string>
 #include <functional>
-#include <mutex>
 #include <unordered_map>
+#include <map>
+#include <set>
+#include <random>
 #include "axi_param.h"
+#include "axi_ring.h"
+
+// When you want one signal for the payload of each channel,
+// instead of one signal for each field, uncomment the following line.
+// VALID and READY stay separate signals.
+//#define AXI_BUS_BUNDLED_SIGNALS
 
 typedef struct struct_axi_trans
 {
 	uint64_t	addr;
-	uint8_t		length;
+	uint16_t	length;	// 1 to AXI_TRANSACTION_LENGTH_MAX
+	uint8_t		burst;	// AXI_BURST_XXX
+	uint8_t		size;	// log2 of bytes in a beat
 	bus_data_t	data[AXI_TRANSACTION_LENGTH_MAX];
+	bus_strb_t	strb[AXI_TRANSACTION_LENGTH_MAX];	// write only
 	bool		is_write;
 } axi_trans_t;
 
@@ -27,79 +39,300 @@ inline std::ostream& operator<<(std::ostream& os, const struct_axi_trans& trans)
 	return os;
 }
 
+// The transaction fifos carry handles into a pool of transactions instead
+// of the bursts themselves, a fifo slot is a pointer whatever the depth.
+// The writer fills an entry from axi_trans_alloc and writes its handle.
+// The reader owns the entry then: it gives it back with axi_trans_free,
+// or writes the handle on, e.g. a request as its own response. Entries
+// are reused, the pool only grows to the transactions in flight at once.
+typedef axi_trans_t* axi_trans_handle_t;
+
+axi_trans_handle_t axi_trans_alloc();	// the content is left over
+axi_trans_handle_t axi_trans_alloc(const axi_trans_t& trans);
+void axi_trans_free(axi_trans_handle_t handle);
+size_t axi_trans_count_allocated();
+size_t axi_trans_count_in_use();
+
+// for the modules that keep a copy of the transaction anyway
+void axi_trans_write(sc_core::sc_fifo_out<axi_trans_handle_t>& out, const axi_trans_t& trans);
+void axi_trans_read(sc_core::sc_fifo_in<axi_trans_handle_t>& in, axi_trans_t& trans);
 
-typedef std::tuple<axi_trans_t, uint8_t> tuple_progress_t;
 
+typedef std::tuple<axi_trans_t, uint16_t> tuple_progress_t;
+
+// one beat of the address channels, AW and AR
 typedef struct
 {
 	uint32_t	id;
 	uint64_t	addr;
 	uint8_t		len; // length - 1
+	uint8_t		burst;
+	uint8_t		size;
+} axi_addr_info_t;
+
+// one beat of the data channels, W and R
+typedef struct
+{
+	uint32_t	id;
 	bus_data_t	data;
+	bus_strb_t	strb;	// W only
 	bool		is_last;
-} axi_bus_info_t;
+} axi_data_info_t;
+
+// one beat of the write response channel, B
+typedef struct
+{
+	uint32_t	id;
+} axi_resp_info_t;
+
+// The following functions are required by 6.23.3 of IEEE std 1666-2011
+// to carry the records on sc_signal.
+
+inline bool operator==(const axi_addr_info_t& a, const axi_addr_info_t& b)
+{
+	return a.id == b.id && a.addr == b.addr && a.len == b.len
+		&& a.burst == b.burst && a.size == b.size;
+}
+
+inline bool operator==(const axi_data_info_t& a, const axi_data_info_t& b)
+{
+	return a.id == b.id && a.data == b.data && a.strb == b.strb && a.is_last == b.is_last;
+}
+
+inline bool operator==(const axi_resp_info_t& a, const axi_resp_info_t& b)
+{
+	return a.id == b.id;
+}
+
+inline std::ostream& operator<<(std::ostream& os, const axi_addr_info_t& info)
+{
+	return os;
+}
+
+inline std::ostream& operator<<(std::ostream& os, const axi_data_info_t& info)
+{
+	return os;
+}
+
+inline std::ostream& operator<<(std::ostream& os, const axi_resp_info_t& info)
+{
+	return os;
+}
+
+// Trace adapters, each field goes to the VCD as its own signal,
+// named as the unbundled signals, e.g. "AW" gives AWID, AWADDR, ...
+
+inline void sc_trace(sc_core::sc_trace_file* tf, const axi_addr_info_t& info, const std::string& name)
+{
+	sc_core::sc_trace(tf, info.id, name + "ID");
+	sc_core::sc_trace(tf, info.addr, name + "ADDR");
+	sc_core::sc_trace(tf, info.len, name + "LEN");
+	sc_core::sc_trace(tf, info.size, name + "SIZE");
+	sc_core::sc_trace(tf, info.burst, name + "BURST");
+}
+
+inline void sc_trace(sc_core::sc_trace_file* tf, const axi_data_info_t& info, const std::string& name)
+{
+	sc_core::sc_trace(tf, info.id, name + "ID");
+	sc_core::sc_trace(tf, info.data, name + "DATA");
+	sc_core::sc_trace(tf, info.strb, name + "STRB");
+	sc_core::sc_trace(tf, info.is_last, name + "LAST");
+}
+
+inline void sc_trace(sc_core::sc_trace_file* tf, const axi_resp_info_t& info, const std::string& name)
+{
+	sc_core::sc_trace(tf, info.id, name + "ID");
+}
+
+// READY generator of a receiving channel
+
+#define READY_ALWAYS	0	// READY whenever downstream is not full
+#define READY_RANDOM	1	// READY with the given probability each cycle
+#define READY_PERIODIC	2	// READY for duty cycles out of every period cycles
+#define READY_CREDIT	3	// READY while q_recv has less than credits entries
+
+typedef struct
+{
+	int			mode;			// READY_XXX
+	double		probability;	// READY_RANDOM
+	uint32_t	period;			// READY_PERIODIC
+	uint32_t	duty;			// READY_PERIODIC
+	size_t		credits;		// READY_CREDIT, slots of q_recv
+} ready_policy_t;
+
+typedef struct
+{
+	uint64_t	count_transfer;		// VALID and READY
+	uint64_t	cycles_stall;		// VALID but not READY
+	uint64_t	cycles_not_ready;
+	size_t		max_occupancy;		// of q_recv
+	uint64_t	cycles_full;		// not READY, q_recv full
+} channel_stats_t;
+
+// one bus word in the write buffer
+typedef struct
+{
+	bus_data_t	data;
+	bus_strb_t	strb;
+} write_buffer_word_t;
+
+class AXI_CHECKPOINT;
+class AXI_TIMELINE;
 
 SC_MODULE(AXI_BUS)
 {
 	sc_in<bool>	ACLK;
 	sc_in<bool>	ARESETn;
 
-	sc_fifo_in<axi_trans_t> request_M;
-	sc_fifo_out<axi_trans_t> response_M;
-	sc_fifo_in<axi_trans_t> response_S;
-	sc_fifo_out<axi_trans_t> request_S;
+	sc_fifo_in<axi_trans_handle_t> request_M;
+	sc_fifo_out<axi_trans_handle_t> response_M;
+	sc_fifo_in<axi_trans_handle_t> response_S;
+	sc_fifo_out<axi_trans_handle_t> request_S;
 
 	// Chapter A2.1.1 write request channel
 	sc_signal<bool>			AWVALID;
 	sc_signal<bool>			AWREADY;
+#ifdef AXI_BUS_BUNDLED_SIGNALS
+	sc_signal<axi_addr_info_t>	AW;
+#else
 	sc_signal<uint32_t>		AWID;
 	sc_signal<uint64_t>		AWADDR;
 	sc_signal<uint8_t>		AWLEN;
+	sc_signal<uint8_t>		AWSIZE;
+	sc_signal<uint8_t>		AWBURST;
+#endif
 
 	// Chapter A2.1.2 write data channel
 	sc_signal<bool>			WVALID;
 	sc_signal<bool>			WREADY;
+#ifdef AXI_BUS_BUNDLED_SIGNALS
+	sc_signal<axi_data_info_t>	W;
+#else
 	sc_signal<uint32_t>		WID;
 	sc_signal<bus_data_t>	WDATA;
+	sc_signal<bus_strb_t>	WSTRB;
 	sc_signal<bool>			WLAST;
+#endif
 
 	// Chapter A2.1.3 write response channel
 	sc_signal<bool>			BVALID;
 	sc_signal<bool>			BREADY;
+#ifdef AXI_BUS_BUNDLED_SIGNALS
+	sc_signal<axi_resp_info_t>	B;
+#else
 	sc_signal<uint32_t>		BID;
+#endif
 
 	// Chapter A2.2.1 read request channel
 	sc_signal<bool>			ARVALID;
 	sc_signal<bool>			ARREADY;
+#ifdef AXI_BUS_BUNDLED_SIGNALS
+	sc_signal<axi_addr_info_t>	AR;
+#else
 	sc_signal<uint32_t>		ARID;
 	sc_signal<uint64_t>		ARADDR;
 	sc_signal<uint8_t>		ARLEN;
+	sc_signal<uint8_t>		ARSIZE;
+	sc_signal<uint8_t>		ARBURST;
+#endif
 
 	// Chapter A2.2.2 read data channel
 	sc_signal<bool>			RVALID;
 	sc_signal<bool>			RREADY;
+#ifdef AXI_BUS_BUNDLED_SIGNALS
+	sc_signal<axi_data_info_t>	R;
+#else
 	sc_signal<uint32_t>		RID;
 	sc_signal<bus_data_t>	RDATA;
 	sc_signal<bool>			RLAST;
+#endif
+
+	// Channel queues, allocated at end of elaboration with the depths below.
+	// A producer waits while its q_send is full, and a receiver is not
+	// READY while its q_recv is full.
+	size_t depth_queue_addr = 16;	// AW, AR
+	size_t depth_queue_data = 64;	// W, R
+	size_t depth_queue_resp = 16;	// B
+
+	AXI_RING<axi_addr_info_t> q_send_AW;
+	AXI_RING<axi_data_info_t> q_send_W;
+	AXI_RING<axi_resp_info_t> q_send_B;
+	AXI_RING<axi_addr_info_t> q_send_AR;
+	AXI_RING<axi_data_info_t> q_send_R;
 
-	std::queue<axi_bus_info_t> q_send_AW;
-	std::queue<axi_bus_info_t> q_send_W;
-	std::queue<axi_bus_info_t> q_send_B;
-	std::queue<axi_bus_info_t> q_send_AR;
-	std::queue<axi_bus_info_t> q_send_R;
+	AXI_RING<axi_addr_info_t> q_recv_AW;
+	AXI_RING<axi_data_info_t> q_recv_W;
+	AXI_RING<axi_resp_info_t> q_recv_B;
+	AXI_RING<axi_addr_info_t> q_recv_AR;
+	AXI_RING<axi_data_info_t> q_recv_R;
 
-	std::queue<axi_bus_info_t> q_recv_AW;
-	std::queue<axi_bus_info_t> q_recv_W;
-	std::queue<axi_bus_info_t> q_recv_B;
-	std::queue<axi_bus_info_t> q_recv_AR;
-	std::queue<axi_bus_info_t> q_recv_R;
+	sc_event event_queue_space;		// a q_send has a free slot
 
-	// To access many queues from many threads, we need to use mutex
-	std::mutex mutex_q;
+	// Synchronization
+	//
+	// All SC_THREADs of the simulation run on one OS thread, and the kernel
+	// switches between them only at wait() or at a blocking read or write of
+	// an sc_fifo. Code between two such points runs without interruption,
+	// so the queues and maps of this module need no lock. The invariants:
+	//
+	// 1. A check and the update it guards (empty/front/pop, full/push,
+	//    find/erase) are never split by a wait() or a blocking fifo access.
+	// 2. Across a blocking point, keep a copy (e.g. the ID), not a reference
+	//    into a queue; the other threads may have popped it meanwhile.
+	// 3. An entry of map_progress lives from progress_create until
+	//    progress_delete, and only the owner of its ID erases it, so the
+	//    elements referenced across a blocking fifo write stay valid.
+	// 4. After waking up, re-check the condition that made the thread wait
+	//    (queue_push loops on full()).
 	sc_event_queue event_something_to_send;
 
 	std::unordered_map<uint32_t, tuple_progress_t> map_progress;
 
+	// Transaction IDs of id_width bits. An ID is taken when the request of
+	// the manager arrives and given back when its response is delivered.
+	// A request waits while no ID is free, so the ID space bounds the
+	// transactions in flight on this bus.
+	int id_width = 8;
+	std::deque<uint32_t> q_id_free;
+	sc_event event_id_free;
+	uint64_t count_stall_id = 0;
+	size_t count_id_used_max = 0;
+
+	// VALID and READY were both high at the last clock edge,
+	// i.e. the receiver took the data. Indexed by channel id.
+	bool is_transferred[CHANNEL_COUNT] = {};
+
+	// Bufferable writes: a complete write goes into the write buffer and
+	// gets its B response at once. Buffered words at the same address are
+	// merged, and contiguous words are drained as INCR bursts when the
+	// buffer is full, idle for a while, or a read touches them.
+	// Reads are served from the buffer when it holds all their bytes,
+	// otherwise they wait until the drained writes are done.
+	bool is_write_buffered = false;
+	size_t depth_write_buffer = 64;			// bus words
+	uint64_t write_buffer_timeout_ns = 16;	// drain when idle this long
+	std::map<uint64_t, write_buffer_word_t> map_write_buffer;	// by word address
+	std::multiset<uint64_t> set_write_drain;	// start of drained bursts in flight
+	std::unordered_map<uint64_t, int> map_write_drain_word;	// words in flight
+	uint64_t stamp_write_buffer_ns = 0;		// last insert
+
+	uint64_t count_write_buffered = 0;
+	uint64_t count_word_merged = 0;
+	uint64_t count_write_drained = 0;		// bursts to the subordinate
+	uint64_t count_read_forwarded = 0;
+	uint64_t count_read_held = 0;
+	int64_t id_read_held = -1;				// front of q_recv_AR, waiting for a drain
+
+	ready_policy_t ready_policy[CHANNEL_COUNT] = {};
+	channel_stats_t channel_stats[CHANNEL_COUNT] = {};
+	uint64_t count_clock = 0;
+	uint32_t seed = 0;
+	std::mt19937 random_engine;
+
+	// timeline export of the transfers and transactions, nullptr is off
+	AXI_TIMELINE* timeline = nullptr;
+	int timeline_pid = 0;
+
 	SC_CTOR(AXI_BUS)
 	{
 		SC_THREAD(thread_clock);
@@ -112,8 +345,12 @@ SC_MODULE(AXI_BUS)
 		SC_THREAD(thread_response_S);
 	}
 
+	void end_of_elaboration() override;
 	void on_clock();
 	void on_reset();
+	void soft_reset();
+	void save_state(AXI_CHECKPOINT& checkpoint);
+	void restore_state(AXI_CHECKPOINT& checkpoint);
 
 	void thread_clock();
 	void thread_request_M();
@@ -121,9 +358,12 @@ SC_MODULE(AXI_BUS)
 	void thread_request_S();
 	void thread_response_S();
 
-	axi_bus_info_t create_null_info();
-	void send_info(int channel, axi_bus_info_t& info);
-	axi_bus_info_t recv_info(int channel);
+	void send_info(int channel, const axi_addr_info_t& info);
+	void send_info(int channel, const axi_data_info_t& info);
+	void send_info(int channel, const axi_resp_info_t& info);
+	void recv_info(int channel, axi_addr_info_t& info);
+	void recv_info(int channel, axi_data_info_t& info);
+	void recv_info(int channel, axi_resp_info_t& info);
 
 	static std::string get_channel_name(int channel);
 	
@@ -131,33 +371,58 @@ SC_MODULE(AXI_BUS)
 	bool is_valid(int channel);
 	void set_ready(int channel, bool value);
 	void set_valid(int channel, bool value);
+	bool is_downstream_full(int channel);
+	bool is_ready_by_policy(int channel, size_t occupancy);
+	void set_ready_policy(int channel, const ready_policy_t& policy);
+	void set_seed(uint32_t seed);
+	void set_timeline(AXI_TIMELINE* timeline);
 
 	void channel_transaction();
 
 	static std::string transaction_to_string(const axi_trans_t& trans);
-	static std::string bus_info_to_string(const axi_bus_info_t& info);
+	static std::string bus_info_to_string(const axi_addr_info_t& info);
+	static std::string bus_info_to_string(const axi_data_info_t& info);
+	static std::string bus_info_to_string(const axi_resp_info_t& info);
 	std::string progress_to_string(const tuple_progress_t& progress);
 
 	void transaction_request_M();
 	void transaction_response_S();
 	void transaction_response_M();
 	void transaction_request_S();
-	std::string transaction_send_info(sc_fifo_out<axi_trans_t>& fifo_out, axi_bus_info_t& info);
+	std::string transaction_send_info(sc_fifo_out<axi_trans_handle_t>& fifo_out, uint32_t id);
+	template <typename T> void queue_push(AXI_RING<T>& q, const T& info);
 
-	bool progress_create(axi_bus_info_t& info, bool is_write);
-	void progress_delete(axi_bus_info_t& info);
-	bool progress_update(std::queue<axi_bus_info_t>& q);
+	void write_buffer_insert(const axi_trans_t& trans);
+	void write_buffer_drain();
+	bool write_buffer_overlaps(const axi_addr_info_t& info);
+	bool write_buffer_forward(const axi_addr_info_t& info);
+	bool write_buffer_absorb(const axi_trans_t& trans);
 
-	void channel_sender(int channel, std::queue<axi_bus_info_t>& q);
-	void channel_receiver(int channel, std::queue<axi_bus_info_t>& q);
+	bool progress_create(const axi_addr_info_t& info, bool is_write);
+	void progress_delete(uint32_t id);
+	bool progress_update(AXI_RING<axi_data_info_t>& q);
+
+	template <typename T> void channel_sender(int channel, AXI_RING<T>& q);
+	template <typename T> void channel_receiver(int channel, AXI_RING<T>& q);
 
 	void log(int channel, std::string action, std::string detail);
 	static void log(std::string source, std::string action, std::string detail);
 
-	uint32_t generate_transaction_id();
+	// debug messages, can be switched at run time.
+	// The defaults come from the DEBUG_AXI_BUS_XXX defines of axi_bus.cpp.
+	static bool is_debug;
+	static bool is_debug_channel;
+	static bool is_debug_progress;
+
+	uint32_t allocate_transaction_id();
+	void release_transaction_id(uint32_t id);
 	void wait_enough_delta_cycles();
 
 	void progress_dump();
+	bool is_idle();
+	void report_outstanding();
+	template <typename T> void report_queue(int channel, const AXI_RING<T>& q_send, const AXI_RING<T>& q_recv);
+	void report_stats();
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,518 @@
+#include <iostream>
+#include <systemc>
+#include <string>
+#include <algorithm>
+#include <sstream>
+
+using namespace sc_core;
+using namespace sc_dt;
+
+#include "axi_cache.h"
+#include "axi_checkpoint.h"
+
+void AXI_CACHE::end_of_elaboration()
+{
+	if (line_bytes < BUS_BYTES || line_bytes % BUS_BYTES != 0
+		|| line_bytes / BUS_BYTES > AXI_TRANSACTION_LENGTH_MAX
+		|| (line_bytes & (line_bytes - 1)) != 0)
+	{
+		SC_REPORT_FATAL("AXI_CACHE", ("Invalid line size " + std::to_string(line_bytes)).c_str());
+	}
+	if (ways < 1 || get_count_set() < 1 || (size_bytes % (line_bytes * ways)) != 0)
+	{
+		SC_REPORT_FATAL("AXI_CACHE", ("Invalid size or ways " + std::to_string(size_bytes)
+			+ "/" + std::to_string(ways)).c_str());
+	}
+	if (replacement == CACHE_REPLACE_PLRU && (ways & (ways - 1)) != 0)
+	{
+		SC_REPORT_FATAL("AXI_CACHE", "PLRU needs power of 2 ways");
+	}
+
+	reset_sets();
+}
+
+// all lines invalid
+
+void AXI_CACHE::reset_sets()
+{
+	cache_line_t line;
+	line.valid = false;
+	line.addr = 0;
+	line.stamp_used = 0;
+	line.data.assign(get_words_per_line(), 0);
+	line.dirty.assign(get_words_per_line(), 0);
+
+	sets.assign(get_count_set(), cache_set_t());
+	for (cache_set_t& set : sets)
+	{
+		set.ways.assign(ways, line);
+		set.plru.assign(ways - 1, false);
+	}
+}
+
+void AXI_CACHE::thread_request()
+{
+	while(true)
+	{
+		fifo_request();
+	}
+}
+
+int AXI_CACHE::get_count_set() const
+{
+	return size_bytes / (line_bytes * ways);
+}
+
+int AXI_CACHE::get_words_per_line() const
+{
+	return line_bytes / BUS_BYTES;
+}
+
+uint64_t AXI_CACHE::get_line_address(uint64_t addr) const
+{
+	return addr & ~((uint64_t) line_bytes - 1);
+}
+
+cache_set_t& AXI_CACHE::get_set(uint64_t line_addr)
+{
+	return sets[(line_addr / line_bytes) % sets.size()];
+}
+
+int AXI_CACHE::find_way(cache_set_t& set, uint64_t line_addr)
+{
+	for (int way = 0; way < ways; way++)
+	{
+		if (set.ways[way].valid && set.ways[way].addr == line_addr)
+		{
+			return way;
+		}
+	}
+	return -1;
+}
+
+// Mark the way as the most recently used one.
+
+void AXI_CACHE::touch(cache_set_t& set, int way)
+{
+	set.ways[way].stamp_used = ++stamp_access;
+
+	// walk from the root to the leaf of the way,
+	// make every node point to the other half.
+	int node = 0;
+	for (int span = ways / 2; span >= 1 && replacement == CACHE_REPLACE_PLRU; span /= 2)
+	{
+		bool is_upper = (way % (span * 2)) >= span;
+		set.plru[node] = !is_upper;
+		node = node * 2 + 1 + (is_upper ? 1 : 0);
+	}
+}
+
+int AXI_CACHE::pick_victim(cache_set_t& set)
+{
+	for (int way = 0; way < ways; way++)
+	{
+		if (!set.ways[way].valid)
+		{
+			return way;
+		}
+	}
+
+	switch (replacement)
+	{
+		case CACHE_REPLACE_PLRU:
+		{
+			// follow the nodes, they point to the less recently used half
+			int node = 0;
+			int way = 0;
+			for (int span = ways / 2; span >= 1; span /= 2)
+			{
+				bool is_upper = set.plru[node];
+				way += is_upper ? span : 0;
+				node = node * 2 + 1 + (is_upper ? 1 : 0);
+			}
+			return way;
+		}
+		case CACHE_REPLACE_RANDOM:
+		{
+			std::uniform_int_distribution<int> dist(0, ways - 1);
+			return dist(random_engine);
+		}
+		case CACHE_REPLACE_LRU:
+		default:
+		{
+			int way_oldest = 0;
+			for (int way = 1; way < ways; way++)
+			{
+				if (set.ways[way].stamp_used < set.ways[way_oldest].stamp_used)
+				{
+					way_oldest = way;
+				}
+			}
+			return way_oldest;
+		}
+	}
+}
+
+// Send one transaction downstream and wait for its response.
+
+axi_trans_t AXI_CACHE::transfer(axi_trans_t& trans)
+{
+	axi_trans_write(request_out, trans);
+	log(__FUNCTION__, "SENT_REQUEST", AXI_BUS::transaction_to_string(trans));
+	axi_trans_t response;
+	axi_trans_read(response_in, response);
+	log(__FUNCTION__, "GOT_RESPONSE", AXI_BUS::transaction_to_string(response));
+	return response;
+}
+
+void AXI_CACHE::write_back(cache_line_t& line)
+{
+	axi_trans_t trans;
+	trans.addr = line.addr;
+	trans.length = get_words_per_line();
+	trans.burst = AXI_BURST_INCR;
+	trans.size = AXI_SIZE_FULL;
+	trans.is_write = true;
+	for (int i = 0; i < trans.length; i++)
+	{
+		// only the dirty bytes are written
+		trans.data[i] = line.data[i];
+		trans.strb[i] = line.dirty[i];
+		line.dirty[i] = 0;
+	}
+
+	count_write_back ++;
+	transfer(trans);
+}
+
+void AXI_CACHE::fill(cache_line_t& line, uint64_t line_addr)
+{
+	axi_trans_t trans;
+	trans.addr = line_addr;
+	trans.length = get_words_per_line();
+	trans.burst = AXI_BURST_INCR;
+	trans.size = AXI_SIZE_FULL;
+	trans.is_write = false;
+
+	count_fill ++;
+	axi_trans_t response = transfer(trans);
+
+	line.valid = true;
+	line.addr = line_addr;
+	for (int i = 0; i < trans.length; i++)
+	{
+		line.data[i] = response.data[i];
+		line.dirty[i] = 0;
+	}
+}
+
+// Look up the line, allocate it on a miss when the policy allows.
+// Returns nullptr when the line is not in the cache.
+
+cache_line_t* AXI_CACHE::access_line(uint64_t line_addr, bool is_write, bool& is_miss)
+{
+	cache_set_t& set = get_set(line_addr);
+	int way = find_way(set, line_addr);
+
+	is_miss = (way < 0);
+	if (!is_miss)
+	{
+		count_hit ++;
+		touch(set, way);
+		return &set.ways[way];
+	}
+
+	count_miss ++;
+	if (is_write && !is_write_allocate)
+	{
+		return nullptr;
+	}
+
+	way = pick_victim(set);
+	cache_line_t& line = set.ways[way];
+	if (line.valid)
+	{
+		count_eviction ++;
+		bool is_dirty = std::any_of(line.dirty.begin(), line.dirty.end(),
+			[](bus_strb_t strb) { return strb != 0; });
+		if (is_dirty)
+		{
+			log(__FUNCTION__, "WRITE_BACK", address_to_hex_string(line.addr));
+			write_back(line);
+		}
+	}
+
+	log(__FUNCTION__, "FILL", address_to_hex_string(line_addr));
+	fill(line, line_addr);
+	touch(set, way);
+	return &line;
+}
+
+void AXI_CACHE::fifo_request()
+{
+	bool is_any_miss = false;
+	bool is_forward = !is_write_back;
+
+	// blocking read, the request becomes the response in place
+	axi_trans_handle_t handle = request_in.read();
+	axi_trans_t& trans = *handle;
+	log(__FUNCTION__, "GOT_REQUEST", AXI_BUS::transaction_to_string(trans));
+	is_busy = true;
+
+	// tag lookup
+	wait(hit_latency_ns, SC_NS);
+
+	uint64_t line_addr_last = UINT64_MAX;
+	cache_line_t* line = nullptr;
+	for (int i = 0; i < trans.length; i++)
+	{
+		uint64_t addr_beat = axi_beat_address(trans.addr, trans.burst, trans.size, trans.length, i);
+		uint64_t addr_word = axi_word_address(addr_beat);
+		uint64_t line_addr = get_line_address(addr_word);
+		int index = (addr_word - line_addr) / BUS_BYTES;
+
+		// beats of a burst mostly share the line
+		if (line_addr != line_addr_last)
+		{
+			bool is_miss;
+			line = access_line(line_addr, trans.is_write, is_miss);
+			is_any_miss |= is_miss;
+			line_addr_last = line_addr;
+		}
+
+		if (line == nullptr)
+		{
+			// write miss, no allocate
+			is_forward = true;
+			continue;
+		}
+
+		if (trans.is_write)
+		{
+			line->data[index] = bus_data_merge(line->data[index], trans.data[i], trans.strb[i]);
+			if (is_write_back)
+			{
+				line->dirty[index] |= trans.strb[i];
+			}
+		}
+		else
+		{
+			trans.data[i] = line->data[index];
+		}
+	}
+
+	if (trans.is_write && is_forward)
+	{
+		count_forward ++;
+		transfer(trans);
+	}
+
+	if (is_any_miss)
+	{
+		wait(miss_latency_ns, SC_NS);
+	}
+
+	response_out.write(handle);
+	log(__FUNCTION__, is_any_miss ? "SENT_RESPONSE_MISS" : "SENT_RESPONSE_HIT",
+		AXI_BUS::transaction_to_string(trans));
+	is_busy = false;
+}
+
+// Put the dirty bytes into the memory image without bus traffic,
+// at the end of the simulation.
+
+void AXI_CACHE::flush_to(AXI_SUBORDINATE& memory)
+{
+	for (cache_set_t& set : sets)
+	{
+		for (cache_line_t& line : set.ways)
+		{
+			for (int i = 0; line.valid && i < get_words_per_line(); i++)
+			{
+				if (line.dirty[i] == 0)
+				{
+					continue;
+				}
+				uint64_t addr = line.addr + (uint64_t) i * BUS_BYTES;
+				memory.write_word(addr, line.data[i], line.dirty[i]);
+				line.dirty[i] = 0;
+			}
+		}
+	}
+}
+
+// The functional path of sampled simulation: the words held by a line
+// are read or written there, the rest in the memory image. Lines are not
+// allocated or touched, so only the detailed phases warm the cache.
+
+void AXI_CACHE::functional_access(axi_trans_t& trans, AXI_SUBORDINATE& memory)
+{
+	for (int i = 0; i < trans.length; i++)
+	{
+		uint64_t addr_beat = axi_beat_address(trans.addr, trans.burst, trans.size, trans.length, i);
+		uint64_t addr = axi_word_address(addr_beat);
+		uint64_t line_addr = get_line_address(addr);
+		cache_set_t& set = get_set(line_addr);
+		int way = find_way(set, line_addr);
+		int word = (addr - line_addr) / BUS_BYTES;
+
+		if (trans.is_write)
+		{
+			if (trans.strb[i] == 0)
+			{
+				continue;
+			}
+			if (way >= 0)
+			{
+				cache_line_t& line = set.ways[way];
+				line.data[word] = bus_data_merge(line.data[word], trans.data[i], trans.strb[i]);
+				if (is_write_back)
+				{
+					line.dirty[word] |= trans.strb[i];
+					continue;
+				}
+			}
+			memory.write_word(addr, trans.data[i], trans.strb[i]);
+		}
+		else if (way >= 0)
+		{
+			trans.data[i] = set.ways[way].data[word];
+		}
+		else
+		{
+			trans.data[i] = 0;
+			memory.read_word(addr, trans.data[i]);
+		}
+	}
+}
+
+void AXI_CACHE::report_stats()
+{
+	uint64_t count_access = count_hit + count_miss;
+
+	std::cout << "CACHE " << name() << ": accesses=" << count_access
+		<< ", hits=" << count_hit
+		<< ", misses=" << count_miss
+		<< ", hit_rate=" << (count_access ? (double) count_hit / count_access : 0)
+		<< std::endl;
+	std::cout << "CACHE " << name() << ": evictions=" << count_eviction
+		<< ", write_backs=" << count_write_back
+		<< ", fills=" << count_fill
+		<< ", forwarded_writes=" << count_forward << std::endl;
+}
+
+// The lines with their dirty lanes, so that a resumed run starts warm.
+// The organization of the restoring cache must be the same.
+
+void AXI_CACHE::save_state(AXI_CHECKPOINT& checkpoint)
+{
+	if (!is_idle())
+	{
+		SC_REPORT_FATAL("AXI_CACHE", "Checkpoint with a request in service");
+	}
+
+	std::ostringstream oss;
+	oss << random_engine;
+
+	checkpoint.put_tag("CACHE:" + std::string(name()));
+	checkpoint.put_uint(get_count_set());
+	checkpoint.put_uint(ways);
+	checkpoint.put_uint(get_words_per_line());
+	checkpoint.put_uint(stamp_access);
+	checkpoint.put_string(oss.str());
+	for (const cache_set_t& set : sets)
+	{
+		for (bool node : set.plru)
+		{
+			checkpoint.put_bool(node);
+		}
+		for (const cache_line_t& line : set.ways)
+		{
+			checkpoint.put_bool(line.valid);
+			if (!line.valid)
+			{
+				continue;
+			}
+			checkpoint.put_uint(line.addr);
+			checkpoint.put_uint(line.stamp_used);
+			for (int i = 0; i < get_words_per_line(); i++)
+			{
+				checkpoint.put_data(line.data[i]);
+				checkpoint.put_uint(line.dirty[i]);
+			}
+		}
+	}
+}
+
+// after elaboration, which allocates the sets
+
+void AXI_CACHE::restore_state(AXI_CHECKPOINT& checkpoint)
+{
+	checkpoint.expect_tag("CACHE:" + std::string(name()));
+	if ((int) checkpoint.get_uint() != get_count_set() || (int) checkpoint.get_uint() != ways
+		|| (int) checkpoint.get_uint() != get_words_per_line())
+	{
+		SC_REPORT_FATAL("AXI_CACHE", "Checkpoint of another cache organization");
+	}
+	stamp_access = checkpoint.get_uint();
+	std::istringstream iss(checkpoint.get_string());
+	iss >> random_engine;
+	for (cache_set_t& set : sets)
+	{
+		for (size_t i = 0; i < set.plru.size(); i++)
+		{
+			set.plru[i] = checkpoint.get_bool();
+		}
+		for (cache_line_t& line : set.ways)
+		{
+			line.valid = checkpoint.get_bool();
+			if (!line.valid)
+			{
+				continue;
+			}
+			line.addr = checkpoint.get_uint();
+			line.stamp_used = checkpoint.get_uint();
+			for (int i = 0; i < get_words_per_line(); i++)
+			{
+				line.data[i] = checkpoint.get_data();
+				line.dirty[i] = checkpoint.get_uint();
+			}
+		}
+	}
+}
+
+// Between the workloads of a batch, with all traffic drained.
+// Dirty lines are dropped, flush_to the memory image first to keep them.
+
+void AXI_CACHE::soft_reset()
+{
+	reset_sets();
+	stamp_access = 0;
+	random_engine.seed(std::mt19937::default_seed);
+	is_busy = false;
+
+	count_hit = 0;
+	count_miss = 0;
+	count_eviction = 0;
+	count_write_back = 0;
+	count_fill = 0;
+	count_forward = 0;
+}
+
+bool AXI_CACHE::is_idle()
+{
+	return !is_busy && request_in->num_available() == 0;
+}
+
+void AXI_CACHE::report_outstanding()
+{
+	std::cout << "CACHE " << name() << ": busy=" << is_busy
+		<< ", request_fifo=" << request_in->num_available() << std::endl;
+}
+
+void AXI_CACHE::log(std::string source, std::string action, std::string detail)
+{
+	std::string sep = ":";
+	std::string log_source = "CACHE" + sep + name() + sep + source;
+	AXI_BUS::log(log_source, action, detail);
+}
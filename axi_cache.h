@@ -0,0 +1,108 @@
+#ifndef __AXI_CACHE_H__
+#define __AXI_CACHE_H__
+
+#include <systemc>
+#include <vector>
+#include <string>
+#include <random>
+#include <unordered_map>
+
+#include "axi_param.h"
+#include "axi_bus.h"
+#include "axi_subordinate.h"
+
+// replacement policy
+#define CACHE_REPLACE_LRU		0
+#define CACHE_REPLACE_PLRU		1	// tree pseudo LRU
+#define CACHE_REPLACE_RANDOM	2
+
+class AXI_CHECKPOINT;
+
+typedef struct
+{
+	bool					valid;
+	uint64_t				addr;			// line address
+	uint64_t				stamp_used;		// LRU
+	std::vector<bus_data_t>	data;			// one bus word each
+	std::vector<bus_strb_t>	dirty;			// dirty byte lanes of each word
+} cache_line_t;
+
+typedef struct
+{
+	std::vector<cache_line_t>	ways;
+	std::vector<bool>			plru;		// tree nodes, ways - 1
+} cache_set_t;
+
+// Set associative cache between AXI_BUS and AXI_SUBORDINATE.
+// Upstream faces the request_S/response_S of the bus, downstream the
+// request/response of the subordinate. Requests are served one at a time,
+// so the downstream response always belongs to the last downstream request.
+
+SC_MODULE(AXI_CACHE)
+{
+	sc_fifo_in<axi_trans_handle_t> request_in;
+	sc_fifo_out<axi_trans_handle_t> response_out;
+	sc_fifo_out<axi_trans_handle_t> request_out;
+	sc_fifo_in<axi_trans_handle_t> response_in;
+
+	// organization, set before the simulation starts
+	int size_bytes = 32 * 1024;
+	int ways = 4;
+	int line_bytes = 64;			// multiple of the bus width
+	int replacement = CACHE_REPLACE_LRU;
+	bool is_write_back = true;		// false is write through
+	bool is_write_allocate = true;
+
+	int hit_latency_ns = 2;
+	int miss_latency_ns = 1;		// added to the downstream time on a miss
+
+	std::vector<cache_set_t> sets;
+	uint64_t stamp_access = 0;
+	std::mt19937 random_engine;
+	bool is_busy = false;		// a request is being served
+
+	// statistics
+	uint64_t count_hit = 0;
+	uint64_t count_miss = 0;
+	uint64_t count_eviction = 0;
+	uint64_t count_write_back = 0;
+	uint64_t count_fill = 0;
+	uint64_t count_forward = 0;		// write through and no allocate writes
+
+	SC_CTOR(AXI_CACHE)
+	{
+		SC_THREAD(thread_request);
+	}
+
+	void end_of_elaboration() override;
+
+	void thread_request();
+	void fifo_request();
+
+	int get_count_set() const;
+	int get_words_per_line() const;
+	uint64_t get_line_address(uint64_t addr) const;
+	cache_set_t& get_set(uint64_t line_addr);
+
+	int find_way(cache_set_t& set, uint64_t line_addr);
+	int pick_victim(cache_set_t& set);
+	void touch(cache_set_t& set, int way);
+	cache_line_t* access_line(uint64_t line_addr, bool is_write, bool& is_miss);
+
+	void fill(cache_line_t& line, uint64_t line_addr);
+	void write_back(cache_line_t& line);
+	axi_trans_t transfer(axi_trans_t& trans);
+
+	void reset_sets();
+	void flush_to(AXI_SUBORDINATE& memory);
+	void functional_access(axi_trans_t& trans, AXI_SUBORDINATE& memory);
+	void report_stats();
+	void soft_reset();
+	void save_state(AXI_CHECKPOINT& checkpoint);
+	void restore_state(AXI_CHECKPOINT& checkpoint);
+	bool is_idle();
+	void report_outstanding();
+	void log(std::string source, std::string action, std::string detail);
+};
+
+#endif
@@ -0,0 +1,232 @@
+#include <iostream>
+#include <systemc>
+#include <fstream>
+#include <string>
+
+using namespace sc_core;
+using namespace sc_dt;
+
+#include "axi_checkpoint.h"
+
+bool AXI_CHECKPOINT::open_write(const std::string& filename, uint64_t stamp_ns)
+{
+	this->filename = filename;
+	this->stamp_ns = stamp_ns;
+	f_out.open(filename, std::ios::binary);
+	if (!f_out.is_open())
+	{
+		std::cerr << "Error: could not open " << filename << std::endl;
+		return false;
+	}
+
+	put_string(CHECKPOINT_MAGIC);
+	put_uint(CHECKPOINT_VERSION);
+	put_uint(DATA_WIDTH);
+	put_uint(stamp_ns);
+	return true;
+}
+
+bool AXI_CHECKPOINT::open_read(const std::string& filename)
+{
+	this->filename = filename;
+	f_in.open(filename, std::ios::binary);
+	if (!f_in.is_open())
+	{
+		std::cerr << "Error: could not open " << filename << std::endl;
+		return false;
+	}
+
+	if (get_string() != CHECKPOINT_MAGIC || get_uint() != CHECKPOINT_VERSION)
+	{
+		std::cerr << "Error: not a checkpoint of this version: " << filename << std::endl;
+		return false;
+	}
+	if (get_uint() != DATA_WIDTH)
+	{
+		std::cerr << "Error: checkpoint of another DATA_WIDTH: " << filename << std::endl;
+		return false;
+	}
+	stamp_ns = get_uint();
+	return true;
+}
+
+void AXI_CHECKPOINT::close()
+{
+	if (f_out.is_open())
+	{
+		put_tag("END");
+		f_out.close();
+		if (f_out.fail())
+		{
+			SC_REPORT_FATAL("AXI_CHECKPOINT", ("Write failed: " + filename).c_str());
+		}
+	}
+	if (f_in.is_open())
+	{
+		expect_tag("END");
+		f_in.close();
+	}
+}
+
+void AXI_CHECKPOINT::put_tag(const std::string& tag)
+{
+	put_string(tag);
+}
+
+// The blocks must come in the order they were written.
+
+void AXI_CHECKPOINT::expect_tag(const std::string& tag)
+{
+	std::string found = get_string();
+	if (found != tag)
+	{
+		std::cerr << "Error: checkpoint " << filename << " has " << found
+			<< " where the model expects " << tag << std::endl;
+		SC_REPORT_FATAL("AXI_CHECKPOINT", "Checkpoint of another topology");
+	}
+}
+
+void AXI_CHECKPOINT::put_uint(uint64_t value)
+{
+	// LEB128, 7 bits each, the high bit tells that more follow
+	while (value >= 0x80)
+	{
+		f_out.put((char) ((value & 0x7f) | 0x80));
+		value >>= 7;
+	}
+	f_out.put((char) value);
+}
+
+void AXI_CHECKPOINT::put_int(int64_t value)
+{
+	// zigzag, so that small negative values stay short
+	put_uint(((uint64_t) value << 1) ^ (uint64_t) (value >> 63));
+}
+
+void AXI_CHECKPOINT::put_string(const std::string& value)
+{
+	put_uint(value.size());
+	f_out.write(value.data(), value.size());
+}
+
+void AXI_CHECKPOINT::put_data(const bus_data_t& data)
+{
+	for (int lane = 0; lane < BUS_BYTES; lane++)
+	{
+		f_out.put((char) data.range(lane * 8 + 7, lane * 8).to_uint64());
+	}
+}
+
+void AXI_CHECKPOINT::put_trans(const axi_trans_t& trans)
+{
+	put_uint(trans.addr);
+	put_uint(trans.length);
+	put_uint(trans.burst);
+	put_uint(trans.size);
+	put_bool(trans.is_write);
+	for (int i = 0; i < trans.length; i++)
+	{
+		put_data(trans.data[i]);
+		put_uint(trans.strb[i]);
+	}
+}
+
+void AXI_CHECKPOINT::put_memory(const std::unordered_map<uint64_t, bus_data_t>& memory)
+{
+	put_uint(memory.size());
+	for (const auto& iter : memory)
+	{
+		put_uint(iter.first);
+		put_data(iter.second);
+	}
+}
+
+uint8_t AXI_CHECKPOINT::get_byte()
+{
+	int c = f_in.get();
+	if (c == EOF)
+	{
+		SC_REPORT_FATAL("AXI_CHECKPOINT", ("Truncated checkpoint " + filename).c_str());
+		return 0;
+	}
+	return (uint8_t) c;
+}
+
+uint64_t AXI_CHECKPOINT::get_uint()
+{
+	uint64_t value = 0;
+	for (int shift = 0; shift < 64; shift += 7)
+	{
+		uint8_t byte = get_byte();
+		value |= (uint64_t) (byte & 0x7f) << shift;
+		if ((byte & 0x80) == 0)
+		{
+			return value;
+		}
+	}
+	SC_REPORT_FATAL("AXI_CHECKPOINT", ("Invalid integer in " + filename).c_str());
+	return 0;
+}
+
+int64_t AXI_CHECKPOINT::get_int()
+{
+	uint64_t value = get_uint();
+	return (int64_t) (value >> 1) ^ -(int64_t) (value & 1);
+}
+
+std::string AXI_CHECKPOINT::get_string()
+{
+	uint64_t size = get_uint();
+	if (size > (1 << 20))
+	{
+		SC_REPORT_FATAL("AXI_CHECKPOINT", ("Invalid string in " + filename).c_str());
+	}
+	std::string value(size, '\0');
+	for (uint64_t i = 0; i < size; i++)
+	{
+		value[i] = (char) get_byte();
+	}
+	return value;
+}
+
+bus_data_t AXI_CHECKPOINT::get_data()
+{
+	bus_data_t data = 0;
+	for (int lane = 0; lane < BUS_BYTES; lane++)
+	{
+		data.range(lane * 8 + 7, lane * 8) = get_byte();
+	}
+	return data;
+}
+
+axi_trans_t AXI_CHECKPOINT::get_trans()
+{
+	axi_trans_t trans;
+	trans.addr = get_uint();
+	trans.length = get_uint();
+	trans.burst = get_uint();
+	trans.size = get_uint();
+	trans.is_write = get_bool();
+	if (trans.length < 1 || trans.length > AXI_TRANSACTION_LENGTH_MAX)
+	{
+		SC_REPORT_FATAL("AXI_CHECKPOINT", ("Invalid transaction in " + filename).c_str());
+	}
+	for (int i = 0; i < trans.length; i++)
+	{
+		trans.data[i] = get_data();
+		trans.strb[i] = get_uint();
+	}
+	return trans;
+}
+
+void AXI_CHECKPOINT::get_memory(std::unordered_map<uint64_t, bus_data_t>& memory)
+{
+	uint64_t count = get_uint();
+	memory.clear();
+	memory.reserve(count);
+	for (uint64_t i = 0; i < count; i++)
+	{
+		uint64_t addr = get_uint();
+		memory[addr] = get_data();
+	}
+}
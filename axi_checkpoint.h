@@ -0,0 +1,71 @@
+#ifndef __AXI_CHECKPOINT_H__
+#define __AXI_CHECKPOINT_H__
+
+#include <string>
+#include <fstream>
+#include <unordered_map>
+
+#include "axi_param.h"
+#include "axi_bus.h"
+
+// Binary checkpoint of the simulation state.
+//
+// SystemC cannot save the stacks of the SC_THREADs, so a checkpoint is
+// only taken when all traffic has drained: the manager holds back the
+// accesses due after the checkpoint time, and once every module is idle
+// their state is just data (memory images, cache lines, the remaining
+// trace, ...). A new process restores it before sc_start and resumes
+// the trace, with the stamps shifted by the checkpoint time.
+//
+// Format: magic, version, DATA_WIDTH, checkpoint time, then one block
+// per module starting with a tag of its kind and name, so that a model
+// of another topology is rejected. Integers are LEB128 varints, bus
+// words are DATA_WIDTH / 8 raw bytes, little endian.
+
+#define CHECKPOINT_MAGIC	"AXICKPT"
+#define CHECKPOINT_VERSION	1
+
+class AXI_CHECKPOINT
+{
+public:
+	bool open_write(const std::string& filename, uint64_t stamp_ns);
+	bool open_read(const std::string& filename);
+	void close();
+
+	uint64_t stamp_ns = 0;		// simulated time of the checkpoint
+	uint64_t stamp_resume_ns = 0;	// the same time in the resumed run
+
+	void put_tag(const std::string& tag);
+	void expect_tag(const std::string& tag);
+
+	void put_uint(uint64_t value);
+	void put_int(int64_t value);
+	void put_bool(bool value) { put_uint(value); }
+	void put_string(const std::string& value);
+	void put_data(const bus_data_t& data);
+	void put_trans(const axi_trans_t& trans);
+	void put_memory(const std::unordered_map<uint64_t, bus_data_t>& memory);
+
+	uint64_t get_uint();
+	int64_t get_int();
+	bool get_bool() { return get_uint() != 0; }
+	std::string get_string();
+	bus_data_t get_data();
+	axi_trans_t get_trans();
+	void get_memory(std::unordered_map<uint64_t, bus_data_t>& memory);
+
+	// a stamp of the checkpointed run, as a stamp of the resumed one
+	uint64_t shift_stamp(uint64_t stamp) const
+	{
+		return (stamp > stamp_ns ? stamp - stamp_ns : 0) + stamp_resume_ns;
+	}
+
+private:
+	std::string filename;
+	std::ofstream f_out;
+	std::ifstream f_in;
+
+	uint8_t get_byte();
+};
+
+#endif
@@ -0,0 +1,308 @@
+#include <iostream>
+#include <systemc>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <algorithm>
+
+using namespace sc_core;
+using namespace sc_dt;
+
+#include "axi_config.h"
+
+static std::string trim(const std::string& s)
+{
+	const char* space = " \t\r\n";
+	size_t begin = s.find_first_not_of(space);
+	if (begin == std::string::npos)
+	{
+		return "";
+	}
+	size_t end = s.find_last_not_of(space);
+	return s.substr(begin, end - begin + 1);
+}
+
+// Every key of the program, whether its stage is enabled or not, so a
+// sweep can turn a stage off and keep its keys. See axi_sim.ini.
+
+static const char* const keys_bus[] =
+{
+	"ready_aw", "ready_w", "ready_b", "ready_ar", "ready_r", "seed", "id_width",
+	"depth_queue_addr", "depth_queue_data", "depth_queue_resp",
+	"write_buffered", "depth_write_buffer", "write_buffer_timeout_ns",
+};
+
+// the sections with the keys of [bus]
+static const char* const sections_bus[] = {"bus", "bus_down"};
+
+static const char* const keys_known[] =
+{
+	"simulation.limit_ns", "simulation.vcd", "simulation.timeline", "simulation.batch",
+	"simulation.workers", "simulation.checkpoint", "simulation.checkpoint_ns",
+	"simulation.checkpoint_stop", "simulation.restore",
+	"sampling.period", "sampling.warmup", "sampling.window", "sampling.confidence",
+	"partition.enable", "partition.lookahead_ns",
+	"fifo.request_M", "fifo.response_M", "fifo.request_S", "fifo.response_S", "fifo.stage",
+	"debug.bus", "debug.channel", "debug.progress",
+	"manager.access", "manager.memory_after", "manager.closed_loop",
+	"manager.max_outstanding_read", "manager.max_outstanding_write",
+	"manager.coalescing", "manager.coalesce_window_ns",
+	"subordinate.model", "subordinate.dram", "subordinate.memory", "subordinate.latency",
+	"subordinate.memory_after", "subordinate.slots", "subordinate.depth_request",
+	"subordinate.unmapped_zero", "subordinate.seed",
+	"width_converter.width",
+	"cache.enable", "cache.size_bytes", "cache.ways", "cache.line_bytes", "cache.replacement",
+	"cache.write_back", "cache.write_allocate", "cache.hit_latency_ns", "cache.miss_latency_ns",
+	"prefetcher.enable", "prefetcher.engine", "prefetcher.streams", "prefetcher.degree",
+	"prefetcher.region_bytes", "prefetcher.block_bytes", "prefetcher.depth_buffer",
+	"prefetcher.max_outstanding",
+};
+
+bool AXI_CONFIG::is_known(const std::string& key)
+{
+	for (const char* known : keys_known)
+	{
+		if (key == known)
+		{
+			return true;
+		}
+	}
+	for (const char* section : sections_bus)
+	{
+		for (const char* known : keys_bus)
+		{
+			if (key == std::string(section) + "." + known)
+			{
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+bool AXI_CONFIG::read_ini(const std::string& filename)
+{
+	std::ifstream f(filename);
+	if (!f.is_open())
+	{
+		std::cerr << "Error: could not open " << filename << std::endl;
+		return false;
+	}
+
+	std::string section;
+	std::string line;
+	int line_number = 0;
+	bool is_ok = true;
+	while (std::getline(f, line))
+	{
+		line_number ++;
+		line = trim(line);
+		if (line.empty() || line[0] == ';' || line[0] == '#')
+		{
+			continue;
+		}
+
+		if (line[0] == '[')
+		{
+			if (line.back() != ']')
+			{
+				std::cerr << "Error: invalid section in " << filename << std::endl;
+				std::cerr << "At line (" << line_number << "): " << line << std::endl;
+				is_ok = false;
+				continue;
+			}
+			section = trim(line.substr(1, line.size() - 2));
+			continue;
+		}
+
+		size_t pos = line.find('=');
+		if (pos == std::string::npos || trim(line.substr(0, pos)).empty())
+		{
+			std::cerr << "Error: invalid format in " << filename << std::endl;
+			std::cerr << "At line (" << line_number << "): " << line << std::endl;
+			is_ok = false;
+			continue;
+		}
+
+		std::string key = trim(line.substr(0, pos));
+		if (!section.empty())
+		{
+			key = section + "." + key;
+		}
+		set(key, trim(line.substr(pos + 1)));
+	}
+	return is_ok;
+}
+
+// Returns false when the program should not run,
+// i.e. on --help or an error.
+
+bool AXI_CONFIG::parse_args(int argc, char* argv[])
+{
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+
+		if (arg == "-h" || arg == "--help")
+		{
+			print_usage(argv[0]);
+			return false;
+		}
+		if (arg == "-c" || arg == "--config")
+		{
+			if (i + 1 >= argc)
+			{
+				std::cerr << "Error: " << arg << " needs a file name" << std::endl;
+				return false;
+			}
+			if (!read_ini(argv[++i]))
+			{
+				return false;
+			}
+			continue;
+		}
+
+		// section.key=value, with or without leading dashes
+		std::string setting = arg;
+		setting.erase(0, std::min(setting.find_first_not_of('-'), setting.size()));
+		size_t pos = setting.find('=');
+		if (pos == std::string::npos || pos == 0)
+		{
+			std::cerr << "Error: unknown argument " << arg << std::endl;
+			print_usage(argv[0]);
+			return false;
+		}
+		set(setting.substr(0, pos), setting.substr(pos + 1));
+	}
+	return true;
+}
+
+void AXI_CONFIG::print_usage(const char* program)
+{
+	std::cout << "usage: " << program << " [-c file.ini]... [section.key=value]..." << std::endl;
+	std::cout << "  -c, --config FILE     read settings from an INI file" << std::endl;
+	std::cout << "  section.key=value     set one value, also as --section.key=value" << std::endl;
+	std::cout << "  -h, --help            show this message" << std::endl;
+	std::cout << "Later settings override earlier ones. See axi_sim.ini for the keys." << std::endl;
+}
+
+void AXI_CONFIG::set(const std::string& key, const std::string& value)
+{
+	map_value[key] = value;
+}
+
+bool AXI_CONFIG::has(const std::string& key) const
+{
+	return map_value.count(key) > 0;
+}
+
+std::string AXI_CONFIG::get_string(const std::string& key, const std::string& value_default)
+{
+	if (!is_known(key))
+	{
+		SC_REPORT_FATAL("AXI_CONFIG", ("Key missing from the list of known keys: " + key).c_str());
+	}
+	auto iter = map_value.find(key);
+	if (iter == map_value.end())
+	{
+		return value_default;
+	}
+	return iter->second;
+}
+
+int64_t AXI_CONFIG::get_int(const std::string& key, int64_t value_default)
+{
+	std::string value = get_string(key, "");
+	if (value.empty())
+	{
+		return value_default;
+	}
+
+	size_t pos = 0;
+	int64_t result = 0;
+	try
+	{
+		// base 0 takes 0x for hex
+		result = std::stoll(value, &pos, 0);
+	}
+	catch (const std::exception&)
+	{
+		pos = 0;
+	}
+	if (pos != value.size())
+	{
+		SC_REPORT_FATAL("AXI_CONFIG", ("Not an integer: " + key + "=" + value).c_str());
+	}
+	return result;
+}
+
+int64_t AXI_CONFIG::get_int(const std::string& key, int64_t value_default, int64_t value_min, int64_t value_max)
+{
+	int64_t result = get_int(key, value_default);
+	if (result < value_min || result > value_max)
+	{
+		SC_REPORT_FATAL("AXI_CONFIG", ("Out of range [" + std::to_string(value_min) + ", "
+			+ std::to_string(value_max) + "]: " + key + "=" + std::to_string(result)).c_str());
+	}
+	return result;
+}
+
+double AXI_CONFIG::get_double(const std::string& key, double value_default)
+{
+	std::string value = get_string(key, "");
+	if (value.empty())
+	{
+		return value_default;
+	}
+
+	size_t pos = 0;
+	double result = 0;
+	try
+	{
+		result = std::stod(value, &pos);
+	}
+	catch (const std::exception&)
+	{
+		pos = 0;
+	}
+	if (pos != value.size())
+	{
+		SC_REPORT_FATAL("AXI_CONFIG", ("Not a number: " + key + "=" + value).c_str());
+	}
+	return result;
+}
+
+bool AXI_CONFIG::get_bool(const std::string& key, bool value_default)
+{
+	std::string value = get_string(key, "");
+	if (value.empty())
+	{
+		return value_default;
+	}
+
+	std::transform(value.begin(), value.end(), value.begin(), ::tolower);
+	if (value == "true" || value == "yes" || value == "on" || value == "1")
+	{
+		return true;
+	}
+	if (value == "false" || value == "no" || value == "off" || value == "0")
+	{
+		return false;
+	}
+	SC_REPORT_FATAL("AXI_CONFIG", ("Not a boolean: " + key + "=" + value).c_str());
+	return value_default;
+}
+
+int AXI_CONFIG::report_unknown()
+{
+	int count = 0;
+	for (auto& iter : map_value)
+	{
+		if (!is_known(iter.first))
+		{
+			std::cerr << "Warning: unknown setting " << iter.first << "=" << iter.second << std::endl;
+			count ++;
+		}
+	}
+	return count;
+}
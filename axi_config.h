@@ -0,0 +1,41 @@
+#ifndef __AXI_CONFIG_H__
+#define __AXI_CONFIG_H__
+
+#include <string>
+#include <map>
+
+// Settings of a simulation run, as "section.key" = "value".
+// They come from INI files and from the command line, later ones win:
+//
+//	project.exe -c sweep.ini bus.id_width=4 --cache.enable=true
+//
+// The INI file has [section] headers, key = value lines, and comments
+// starting with ; or #. See axi_sim.ini for all the keys.
+
+class AXI_CONFIG
+{
+public:
+	bool read_ini(const std::string& filename);
+	bool parse_args(int argc, char* argv[]);
+	void print_usage(const char* program);
+
+	void set(const std::string& key, const std::string& value);
+	bool has(const std::string& key) const;
+
+	// The value of the key, or value_default when it is not set.
+	std::string get_string(const std::string& key, const std::string& value_default);
+	int64_t get_int(const std::string& key, int64_t value_default);
+	int64_t get_int(const std::string& key, int64_t value_default, int64_t value_min, int64_t value_max);
+	double get_double(const std::string& key, double value_default);
+	bool get_bool(const std::string& key, bool value_default);
+
+	// Keys set but unknown to the program, most likely typos, whether
+	// their stage is enabled or not. Returns their count.
+	int report_unknown();
+	static bool is_known(const std::string& key);
+
+private:
+	std::map<std::string, std::string> map_value;
+};
+
+#endif
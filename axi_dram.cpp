@@ -0,0 +1,414 @@
+#include <iostream>
+#include <systemc>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <algorithm>
+
+using namespace sc_core;
+using namespace sc_dt;
+
+#include "axi_dram.h"
+#include "axi_checkpoint.h"
+
+#define NANOSECONDS_PER_SECOND (1000 * 1000 * 1000)
+
+void AXI_SUBORDINATE_DRAM::set_default_param()
+{
+	// one channel, one rank, 8 banks, 2 KiB rows of 128 bit words
+	param.column_bits = 7;
+	param.channel_bits = 0;
+	param.bank_bits = 3;
+	param.rank_bits = 0;
+
+	param.tRCD = 14;
+	param.tCL = 14;
+	param.tCWL = 10;
+	param.tRP = 14;
+	param.tWR = 15;
+	param.tBURST = 1;
+
+	reset_banks();
+}
+
+void AXI_SUBORDINATE_DRAM::reset_banks()
+{
+	int count_channel = 1 << param.channel_bits;
+	int count_bank = count_channel << (param.rank_bits + param.bank_bits);
+
+	banks.assign(count_bank, dram_bank_t{-1, 0});
+	channel_ready_ns.assign(count_channel, 0);
+}
+
+void AXI_SUBORDINATE_DRAM::read_dram_csv()
+{
+	std::ifstream f(filename_dram);
+	if (!f.is_open())
+	{
+		std::cerr << "Error: could not open " << filename_dram << std::endl;
+		return;
+	}
+
+	int line_number = 1;
+	std::string line;
+	while (std::getline(f, line))
+	{
+		// line format
+		// key, value
+		//
+		// key: one of the dram_param_t field names
+		// value: integer, bit count or nano seconds
+		//
+		// empty lines and lines starting with '#' are ignored.
+
+		if (line.empty() || line[0] == '#')
+		{
+			line_number ++;
+			continue;
+		}
+
+		std::istringstream iss(line);
+		std::string key, value;
+		std::getline(iss, key, ',');
+		std::getline(iss, value, ',');
+		key.erase(key.find_last_not_of(" \t") + 1);
+		value.erase(0, value.find_first_not_of(" \t"));
+		value.erase(value.find_last_not_of(" \t\r") + 1);
+
+		// the whole value, unsigned
+		uint64_t n = 0;
+		size_t pos = 0;
+		try
+		{
+			if (!value.empty() && value[0] != '-')
+			{
+				n = std::stoull(value, &pos);
+			}
+		}
+		catch (const std::exception&)
+		{
+			pos = 0;
+		}
+		if (key.empty() || value.empty() || pos != value.size())
+		{
+			std::cerr << "Error: invalid format in " << filename_dram << std::endl;
+			std::cerr << "At line (" << line_number << "): " << line << std::endl;
+			SC_REPORT_FATAL("AXI_SUBORDINATE_DRAM", "Invalid DRAM parameters");
+		}
+
+		bool is_bits = key.size() > 5 && key.compare(key.size() - 5, 5, "_bits") == 0;
+		if (is_bits && n > DRAM_FIELD_BITS_MAX)
+		{
+			std::cerr << "Error: too many bits in " << filename_dram << std::endl;
+			std::cerr << "At line (" << line_number << "): " << line << std::endl;
+			SC_REPORT_FATAL("AXI_SUBORDINATE_DRAM", "Invalid DRAM parameters");
+		}
+
+		if (key == "column_bits")		param.column_bits = n;
+		else if (key == "channel_bits")	param.channel_bits = n;
+		else if (key == "bank_bits")	param.bank_bits = n;
+		else if (key == "rank_bits")	param.rank_bits = n;
+		else if (key == "tRCD")			param.tRCD = n;
+		else if (key == "tCL")			param.tCL = n;
+		else if (key == "tCWL")			param.tCWL = n;
+		else if (key == "tRP")			param.tRP = n;
+		else if (key == "tWR")			param.tWR = n;
+		else if (key == "tBURST")		param.tBURST = n;
+		else
+		{
+			std::cerr << "Error: unknown key in " << filename_dram << std::endl;
+			std::cerr << "At line (" << line_number << "): " << line << std::endl;
+			SC_REPORT_FATAL("AXI_SUBORDINATE_DRAM", "Invalid DRAM parameters");
+		}
+		line_number ++;
+	}
+
+	// one bank state per channel, rank and bank
+	if (param.channel_bits + param.rank_bits + param.bank_bits > DRAM_BANK_INDEX_BITS_MAX)
+	{
+		std::cerr << "Error: channel_bits + rank_bits + bank_bits above "
+			<< DRAM_BANK_INDEX_BITS_MAX << " in " << filename_dram << std::endl;
+		SC_REPORT_FATAL("AXI_SUBORDINATE_DRAM", "Invalid DRAM parameters");
+	}
+
+	reset_banks();
+}
+
+dram_address_t AXI_SUBORDINATE_DRAM::map_address(uint64_t addr)
+{
+	dram_address_t location;
+	uint64_t word = addr / (DATA_WIDTH / 8);
+
+	word >>= param.column_bits;
+	location.channel = word & ((1ULL << param.channel_bits) - 1);
+	word >>= param.channel_bits;
+	location.bank = word & ((1ULL << param.bank_bits) - 1);
+	word >>= param.bank_bits;
+	location.rank = word & ((1ULL << param.rank_bits) - 1);
+	word >>= param.rank_bits;
+	location.row = word;
+	return location;
+}
+
+dram_bank_t& AXI_SUBORDINATE_DRAM::get_bank(const dram_address_t& location)
+{
+	uint32_t index = location.channel;
+	index = (index << param.rank_bits) | location.rank;
+	index = (index << param.bank_bits) | location.bank;
+	return banks[index];
+}
+
+void AXI_SUBORDINATE_DRAM::fifo_reader()
+{
+	axi_trans_handle_t trans;
+	uint64_t stamp_now_ns;
+
+	// The pending queue is the request queue of the controller.
+	if (depth_request_max > 0 && q_pending.size() >= (size_t) depth_request_max)
+	{
+		log(__FUNCTION__, "FULL", "pending=" + std::to_string(q_pending.size()));
+		wait(event_slot_free);
+		return;
+	}
+
+	// Receive incoming requests. This is a blocking read.
+	trans = request.read();
+	log(__FUNCTION__, "GOT_REQUEST", AXI_BUS::transaction_to_string(*trans));
+
+	// +0.5 is needed for rounding
+	stamp_now_ns = sc_time_stamp().to_seconds() * NANOSECONDS_PER_SECOND + 0.5;
+
+	dram_request_t req;
+	req.stamp_arrival = stamp_now_ns;
+	req.location = map_address(trans->addr);
+	req.trans = trans;
+	q_pending.push_back(req);
+	max_request_occupancy = std::max(max_request_occupancy, q_pending.size());
+	event_request.notify(SC_ZERO_TIME);
+
+	log(__FUNCTION__, "PENDING", "pending=" + std::to_string(q_pending.size())
+		+ ", bank=" + std::to_string(req.location.bank)
+		+ ", row=" + std::to_string(req.location.row));
+}
+
+// FR-FCFS: the oldest request hitting an open row wins,
+// otherwise the oldest request whose bank is free.
+// Returns -1 when every pending request waits for a busy bank,
+// stamp_bank_ready_ns is then the earliest time a bank gets free.
+
+int AXI_SUBORDINATE_DRAM::pick_request(uint64_t stamp_now_ns, uint64_t& stamp_bank_ready_ns)
+{
+	int index_first_ready = -1;
+
+	stamp_bank_ready_ns = UINT64_MAX;
+	for (size_t i = 0; i < q_pending.size(); i++)
+	{
+		dram_bank_t& bank = get_bank(q_pending[i].location);
+		if (bank.ready_ns > stamp_now_ns)
+		{
+			stamp_bank_ready_ns = std::min(stamp_bank_ready_ns, bank.ready_ns);
+			continue;
+		}
+		if (bank.open_row == (int64_t) q_pending[i].location.row)
+		{
+			return i;
+		}
+		if (index_first_ready < 0)
+		{
+			index_first_ready = i;
+		}
+	}
+	return index_first_ready;
+}
+
+void AXI_SUBORDINATE_DRAM::issue_request(int index, uint64_t stamp_now_ns)
+{
+	std::string log_action;
+	dram_request_t req = q_pending[index];
+	q_pending.erase(q_pending.begin() + index);
+	event_slot_free.notify(SC_ZERO_TIME);
+
+	uint64_t queueing_ns = stamp_now_ns - req.stamp_arrival;
+	sum_queueing_ns += queueing_ns;
+	max_queueing_ns = std::max(max_queueing_ns, queueing_ns);
+	count_in_service ++;
+
+	dram_bank_t& bank = get_bank(req.location);
+	uint64_t& channel_ready = channel_ready_ns[req.location.channel];
+	uint64_t stamp_column_ns = stamp_now_ns;
+
+	if (bank.open_row == (int64_t) req.location.row)
+	{
+		count_row_hit ++;
+		log_action = "ROW_HIT";
+	}
+	else if (bank.open_row < 0)
+	{
+		count_row_miss ++;
+		stamp_column_ns += param.tRCD;
+		log_action = "ROW_MISS";
+	}
+	else
+	{
+		count_row_conflict ++;
+		stamp_column_ns += param.tRP + param.tRCD;
+		log_action = "ROW_CONFLICT";
+	}
+
+	// data follows the column command, once the channel is free.
+	uint64_t latency_column = req.trans->is_write ? param.tCWL : param.tCL;
+	uint64_t stamp_data_ns = std::max(stamp_column_ns + latency_column, channel_ready);
+	uint64_t stamp_done_ns = stamp_data_ns + param.tBURST * req.trans->length;
+
+	channel_ready = stamp_done_ns;
+	bank.open_row = req.location.row;
+	bank.ready_ns = stamp_column_ns + param.tBURST * req.trans->length;
+	if (req.trans->is_write)
+	{
+		bank.ready_ns = std::max(bank.ready_ns, stamp_done_ns + param.tWR);
+	}
+
+	if (count_bytes == 0)
+	{
+		stamp_first_ns = req.stamp_arrival;
+	}
+	count_bytes += (uint64_t) req.trans->length << req.trans->size;
+	stamp_last_ns = stamp_done_ns;
+
+	event_something_to_send.notify(stamp_done_ns - stamp_now_ns, SC_NS);
+	q_send.push(when_trans_t(stamp_done_ns, req.trans));
+
+	std::string log_detail;
+	log_detail = "scheduled=" + std::to_string(stamp_done_ns);
+	log_detail += ", queued=" + std::to_string(stamp_now_ns - req.stamp_arrival);
+	log_detail += ", bank=" + std::to_string(req.location.bank);
+	log_detail += ", row=" + std::to_string(req.location.row);
+	log_detail += ", " + AXI_BUS::transaction_to_string(*req.trans);
+	log(__FUNCTION__, log_action, log_detail);
+}
+
+void AXI_SUBORDINATE_DRAM::thread_scheduler()
+{
+	while(true)
+	{
+		if (q_pending.empty())
+		{
+			wait(event_request);
+			continue;
+		}
+
+		// the service slots, freed when a response is sent
+		if (count_slot_max > 0 && count_in_service >= count_slot_max)
+		{
+			log(__FUNCTION__, "NO_SLOT", "pending=" + std::to_string(q_pending.size())
+				+ ", in_service=" + std::to_string(count_in_service));
+			wait(event_slot_free);
+			continue;
+		}
+
+		// +0.5 is needed for rounding
+		uint64_t stamp_now_ns = sc_time_stamp().to_seconds() * NANOSECONDS_PER_SECOND + 0.5;
+		uint64_t stamp_bank_ready_ns;
+		int index = pick_request(stamp_now_ns, stamp_bank_ready_ns);
+
+		if (index < 0)
+		{
+			// all banks busy, wait for one of them or a new request
+			wait(stamp_bank_ready_ns - stamp_now_ns, SC_NS, event_request);
+			continue;
+		}
+
+		issue_request(index, stamp_now_ns);
+
+		// one command per nano second
+		wait(1, SC_NS);
+	}
+}
+
+void AXI_SUBORDINATE_DRAM::soft_reset()
+{
+	AXI_SUBORDINATE::soft_reset();
+	q_pending.clear();
+	reset_banks();
+
+	count_row_hit = 0;
+	count_row_miss = 0;
+	count_row_conflict = 0;
+	count_bytes = 0;
+	stamp_first_ns = 0;
+	stamp_last_ns = 0;
+}
+
+// open rows and busy times of the banks, after the memory image
+
+void AXI_SUBORDINATE_DRAM::save_state(AXI_CHECKPOINT& checkpoint)
+{
+	AXI_SUBORDINATE::save_state(checkpoint);
+	checkpoint.put_tag("DRAM:" + std::string(name()));
+	checkpoint.put_uint(banks.size());
+	for (const dram_bank_t& bank : banks)
+	{
+		checkpoint.put_int(bank.open_row);
+		checkpoint.put_uint(bank.ready_ns);
+	}
+	checkpoint.put_uint(channel_ready_ns.size());
+	for (uint64_t ready_ns : channel_ready_ns)
+	{
+		checkpoint.put_uint(ready_ns);
+	}
+}
+
+void AXI_SUBORDINATE_DRAM::restore_state(AXI_CHECKPOINT& checkpoint)
+{
+	AXI_SUBORDINATE::restore_state(checkpoint);
+	checkpoint.expect_tag("DRAM:" + std::string(name()));
+	if (checkpoint.get_uint() != banks.size())
+	{
+		SC_REPORT_FATAL("AXI_SUBORDINATE_DRAM", "Checkpoint of another bank organization");
+	}
+	for (dram_bank_t& bank : banks)
+	{
+		bank.open_row = checkpoint.get_int();
+		bank.ready_ns = checkpoint.shift_stamp(checkpoint.get_uint());
+	}
+	if (checkpoint.get_uint() != channel_ready_ns.size())
+	{
+		SC_REPORT_FATAL("AXI_SUBORDINATE_DRAM", "Checkpoint of another channel count");
+	}
+	for (uint64_t& ready_ns : channel_ready_ns)
+	{
+		ready_ns = checkpoint.shift_stamp(checkpoint.get_uint());
+	}
+}
+
+bool AXI_SUBORDINATE_DRAM::is_idle()
+{
+	return q_pending.empty() && AXI_SUBORDINATE::is_idle();
+}
+
+void AXI_SUBORDINATE_DRAM::report_outstanding()
+{
+	AXI_SUBORDINATE::report_outstanding();
+	std::cout << "SUBORDINATE " << name() << ": pending=" << q_pending.size() << std::endl;
+}
+
+void AXI_SUBORDINATE_DRAM::report_stats()
+{
+	AXI_SUBORDINATE::report_stats();
+
+	uint64_t count_total = count_row_hit + count_row_miss + count_row_conflict;
+	uint64_t duration_ns = stamp_last_ns - stamp_first_ns;
+
+	std::cout << "DRAM " << name() << ": requests=" << count_total
+		<< ", row_hit=" << count_row_hit
+		<< ", row_miss=" << count_row_miss
+		<< ", row_conflict=" << count_row_conflict << std::endl;
+	if (count_total > 0)
+	{
+		std::cout << "DRAM " << name() << ": hit_rate="
+			<< (double) count_row_hit / count_total
+			<< ", bytes=" << count_bytes
+			<< ", bandwidth=" << (duration_ns ? (double) count_bytes / duration_ns : 0)
+			<< " bytes/ns" << std::endl;
+	}
+}
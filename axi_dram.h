@@ -0,0 +1,107 @@
+#ifndef __AXI_DRAM_H__
+#define __AXI_DRAM_H__
+
+#include <deque>
+#include <vector>
+#include <string>
+
+#include "axi_param.h"
+#include "axi_bus.h"
+#include "axi_subordinate.h"
+
+// DRAM organization and timing.
+// Address mapping from LSB to MSB is
+// offset (bus width) | column | channel | bank | rank | row.
+// All timings are in nano seconds.
+
+#define DRAM_FIELD_BITS_MAX		32	// any one of the *_bits
+#define DRAM_BANK_INDEX_BITS_MAX	24	// channel_bits + rank_bits + bank_bits
+
+typedef struct
+{
+	int			column_bits;
+	int			channel_bits;
+	int			bank_bits;
+	int			rank_bits;
+
+	uint64_t	tRCD;		// activate to column command
+	uint64_t	tCL;		// read column command to data
+	uint64_t	tCWL;		// write column command to data
+	uint64_t	tRP;		// precharge to activate
+	uint64_t	tWR;		// end of write data to precharge
+	uint64_t	tBURST;		// one data beat on the channel
+} dram_param_t;
+
+typedef struct
+{
+	uint32_t	channel;
+	uint32_t	rank;
+	uint32_t	bank;
+	uint64_t	row;
+} dram_address_t;
+
+typedef struct
+{
+	int64_t		open_row;	// -1 when precharged
+	uint64_t	ready_ns;	// when the bank accepts the next command
+} dram_bank_t;
+
+typedef struct
+{
+	uint64_t		stamp_arrival;
+	dram_address_t	location;
+	axi_trans_handle_t	trans;
+} dram_request_t;
+
+// AXI_SUBORDINATE with a DRAM controller in front of the memory.
+// Requests are kept in a pending queue, and the FR-FCFS scheduler
+// picks the oldest row hit first, then the oldest request to a free bank.
+
+class AXI_SUBORDINATE_DRAM : public AXI_SUBORDINATE
+{
+public:
+	SC_HAS_PROCESS(AXI_SUBORDINATE_DRAM);
+
+	AXI_SUBORDINATE_DRAM(sc_module_name name) : AXI_SUBORDINATE(name)
+	{
+		set_default_param();
+		SC_THREAD(thread_scheduler);
+	}
+
+	dram_param_t param;
+	std::string filename_dram = "s_dram.csv";
+
+	std::deque<dram_request_t> q_pending;
+	std::vector<dram_bank_t> banks;
+	std::vector<uint64_t> channel_ready_ns;
+	sc_event event_request;
+
+	// statistics
+	uint64_t count_row_hit = 0;
+	uint64_t count_row_miss = 0;	// bank was precharged
+	uint64_t count_row_conflict = 0;	// other row was open
+	uint64_t count_bytes = 0;
+	uint64_t stamp_first_ns = 0;
+	uint64_t stamp_last_ns = 0;
+
+	void fifo_reader() override;
+	void thread_scheduler();
+
+	void set_default_param();
+	void read_dram_csv();
+	void reset_banks();
+
+	dram_address_t map_address(uint64_t addr);
+	dram_bank_t& get_bank(const dram_address_t& location);
+	int pick_request(uint64_t stamp_now_ns, uint64_t& stamp_bank_ready_ns);
+	void issue_request(int index, uint64_t stamp_now_ns);
+
+	void report_stats() override;
+	void soft_reset() override;
+	void save_state(AXI_CHECKPOINT& checkpoint) override;
+	void restore_state(AXI_CHECKPOINT& checkpoint) override;
+	bool is_idle() override;
+	void report_outstanding() override;
+};
+
+#endif
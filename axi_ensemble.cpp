@@ -0,0 +1,261 @@
+#include <iostream>
+#include <systemc>
+#include <cerrno>
+#include <climits>
+#include <csignal>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/wait.h>
+
+using namespace sc_core;
+using namespace sc_dt;
+
+#include "axi_ensemble.h"
+
+#define ENSEMBLE_NONE	UINT64_MAX	// no workload
+
+static_assert(sizeof(ensemble_result_t) <= PIPE_BUF, "results must be written atomically");
+
+static bool read_full(int fd, void* buffer, size_t size)
+{
+	char* p = (char*) buffer;
+	while (size > 0)
+	{
+		ssize_t count = read(fd, p, size);
+		if (count < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (count <= 0)
+		{
+			return false;
+		}
+		p += count;
+		size -= count;
+	}
+	return true;
+}
+
+static bool write_full(int fd, const void* buffer, size_t size)
+{
+	const char* p = (const char*) buffer;
+	while (size > 0)
+	{
+		ssize_t count = write(fd, p, size);
+		if (count < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (count <= 0)
+		{
+			return false;
+		}
+		p += count;
+		size -= count;
+	}
+	return true;
+}
+
+void AXI_ENSEMBLE::execute(uint64_t count_workload, std::vector<ensemble_result_t>& list_result)
+{
+	list_result.assign(count_workload, ensemble_result_t{});
+	uint64_t count_result = 0;
+	uint64_t index_next = 0;
+
+	if (pipe(fd_result) != 0)
+	{
+		SC_REPORT_FATAL("AXI_ENSEMBLE", "Cannot create the result pipe");
+	}
+
+	// a dead worker shows up in reap(), not as SIGPIPE
+	signal(SIGPIPE, SIG_IGN);
+
+	while (count_result < count_workload)
+	{
+		// every idle worker gets the next workload, or no more
+		for (ensemble_worker_t& worker : list_worker)
+		{
+			if (worker.fd_task < 0 || worker.is_exiting || worker.index != ENSEMBLE_NONE)
+			{
+				continue;
+			}
+			if (index_next < count_workload)
+			{
+				dispatch(worker, index_next ++);
+			}
+			else
+			{
+				close(worker.fd_task);
+				worker.fd_task = -1;
+			}
+		}
+
+		// keep count_worker workers busy while workloads remain
+		int count_running = 0;
+		for (const ensemble_worker_t& worker : list_worker)
+		{
+			count_running += worker.index != ENSEMBLE_NONE && !worker.is_exiting;
+		}
+		while (count_running < count_worker && index_next < count_workload)
+		{
+			if (!fork_worker())
+			{
+				if (list_worker.empty())
+				{
+					SC_REPORT_FATAL("AXI_ENSEMBLE", "Cannot fork a worker");
+				}
+				break;
+			}
+			dispatch(list_worker.back(), index_next ++);
+			count_running ++;
+		}
+
+		// wait for a result, and look for dead workers now and then
+		pollfd p = {fd_result[0], POLLIN, 0};
+		poll(&p, 1, 1000);
+		reap(list_result, count_result);
+	}
+
+	// the rest have no more work and exit
+	for (ensemble_worker_t& worker : list_worker)
+	{
+		if (worker.fd_task >= 0)
+		{
+			close(worker.fd_task);
+		}
+		waitpid(worker.pid, nullptr, 0);
+	}
+	list_worker.clear();
+	close(fd_result[0]);
+	close(fd_result[1]);
+}
+
+// Results first, then the workers that exited. A worker writes its
+// result before it exits, so a worker found dead with its workload still
+// open has crashed.
+
+void AXI_ENSEMBLE::reap(std::vector<ensemble_result_t>& list_result, uint64_t& count_result)
+{
+	std::vector<pid_t> list_exited;
+	pid_t pid;
+	while ((pid = waitpid(-1, nullptr, WNOHANG)) > 0)
+	{
+		list_exited.push_back(pid);
+	}
+
+	pollfd p = {fd_result[0], POLLIN, 0};
+	while (poll(&p, 1, 0) > 0 && (p.revents & POLLIN))
+	{
+		ensemble_result_t result;
+		if (!read_full(fd_result[0], &result, sizeof(result)) || result.index >= list_result.size())
+		{
+			SC_REPORT_FATAL("AXI_ENSEMBLE", "Invalid result from a worker");
+		}
+		list_result[result.index] = result;
+		count_result ++;
+
+		for (ensemble_worker_t& worker : list_worker)
+		{
+			if (worker.pid == result.pid)
+			{
+				worker.index = ENSEMBLE_NONE;
+				worker.is_exiting = result.status != ENSEMBLE_COMPLETED;
+			}
+		}
+	}
+
+	for (pid_t pid_exited : list_exited)
+	{
+		for (auto iter = list_worker.begin(); iter != list_worker.end(); iter++)
+		{
+			if (iter->pid != pid_exited)
+			{
+				continue;
+			}
+			if (iter->index != ENSEMBLE_NONE)
+			{
+				ensemble_result_t& result = list_result[iter->index];
+				result = ensemble_result_t{};
+				result.index = iter->index;
+				result.status = ENSEMBLE_CRASHED;
+				result.pid = pid_exited;
+				count_result ++;
+			}
+			if (iter->fd_task >= 0)
+			{
+				close(iter->fd_task);
+			}
+			list_worker.erase(iter);
+			break;
+		}
+	}
+}
+
+void AXI_ENSEMBLE::dispatch(ensemble_worker_t& worker, uint64_t index)
+{
+	worker.index = index;
+	if (!write_full(worker.fd_task, &index, sizeof(index)))
+	{
+		// found dead by reap(), the workload counts as crashed
+		std::cerr << "Error: could not send workload " << index
+			<< " to worker " << worker.pid << std::endl;
+	}
+}
+
+bool AXI_ENSEMBLE::fork_worker()
+{
+	int fd_task[2];
+	if (pipe(fd_task) != 0)
+	{
+		return false;
+	}
+
+	// the buffers would be written once more by the worker
+	std::cout.flush();
+	std::cerr.flush();
+	pid_t pid = fork();
+	if (pid < 0)
+	{
+		close(fd_task[0]);
+		close(fd_task[1]);
+		return false;
+	}
+	if (pid == 0)
+	{
+		close(fd_task[1]);
+		close(fd_result[0]);
+		for (const ensemble_worker_t& worker : list_worker)
+		{
+			if (worker.fd_task >= 0)
+			{
+				close(worker.fd_task);
+			}
+		}
+		worker_loop(fd_task[0]);
+	}
+
+	close(fd_task[0]);
+	list_worker.push_back({pid, fd_task[1], ENSEMBLE_NONE, false});
+	return true;
+}
+
+// In the worker, until its pipe is closed or a workload times out.
+
+void AXI_ENSEMBLE::worker_loop(int fd_task)
+{
+	uint64_t index;
+	while (read_full(fd_task, &index, sizeof(index)))
+	{
+		ensemble_result_t result = {};
+		result.index = index;
+		result.pid = getpid();
+		run(index, result);
+		std::cout.flush();
+		if (!write_full(fd_result[1], &result, sizeof(result)) || result.status != ENSEMBLE_COMPLETED)
+		{
+			break;
+		}
+	}
+	std::cout.flush();
+	_exit(0);
+}
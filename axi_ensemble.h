@@ -0,0 +1,70 @@
+#ifndef __AXI_ENSEMBLE_H__
+#define __AXI_ENSEMBLE_H__
+
+#include <vector>
+#include <functional>
+#include <cstdint>
+#include <sys/types.h>
+
+// Ensemble runner: the workloads of a batch spread over worker processes.
+//
+// The SystemC kernel is one per process, so parallel runs need processes.
+// The parent elaborates the model and reads the shared inputs (latency
+// tables, memory images) once, then forks the workers, which share those
+// pages copy-on-write. Each worker gets workload indices through its own
+// pipe and sends back a fixed size result through a common pipe; results
+// are smaller than PIPE_BUF, so the writes of the workers do not mix.
+//
+// A worker whose workload timed out cannot run another one, because its
+// kernel is stopped. It exits after its result, and the parent forks a
+// fresh one from its untouched state.
+
+#define ENSEMBLE_COMPLETED	0
+#define ENSEMBLE_TIMEOUT	1
+#define ENSEMBLE_CRASHED	2	// the worker exited without a result
+
+// the result of one workload
+typedef struct
+{
+	uint64_t	index;
+	int32_t		status;		// ENSEMBLE_XXX
+	int32_t		pid;
+	uint64_t	duration_ns;
+	uint64_t	count_clock;
+	uint64_t	wall_ns;
+	uint64_t	count_retired;
+	uint64_t	sum_latency_ns;
+	uint64_t	max_latency_ns;
+	uint64_t	count_bytes;
+} ensemble_result_t;
+
+typedef struct
+{
+	pid_t		pid;
+	int			fd_task;	// write end, to the worker
+	uint64_t	index;		// the workload it runs
+	bool		is_exiting;	// after a timeout
+} ensemble_worker_t;
+
+class AXI_ENSEMBLE
+{
+public:
+	int count_worker = 1;
+
+	// runs one workload in a worker, fills the result
+	std::function<void(uint64_t index, ensemble_result_t& result)> run;
+
+	// in the parent, returns when every workload has a result
+	void execute(uint64_t count_workload, std::vector<ensemble_result_t>& list_result);
+
+private:
+	int fd_result[2];
+	std::vector<ensemble_worker_t> list_worker;
+
+	bool fork_worker();
+	void worker_loop(int fd_task);
+	void dispatch(ensemble_worker_t& worker, uint64_t index);
+	void reap(std::vector<ensemble_result_t>& list_result, uint64_t& count_result);
+};
+
+#endif
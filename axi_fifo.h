@@ -0,0 +1,155 @@
+#ifndef __AXI_FIFO_H__
+#define __AXI_FIFO_H__
+
+#include <systemc>
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cstdint>
+
+// sc_fifo with a configurable depth and occupancy statistics, for the
+// transaction fifos between the modules.
+//
+// The transaction fifos carry axi_trans_handle_t, a slot is a pointer
+// into the pool of transactions, so the depth sets how far a producer
+// runs ahead of its consumer and costs next to no memory. Each write
+// records the occupancy it leaves behind, and each read or write that
+// has to wait records how long, in simulated time. A consumer blocked in read() is
+// starved, a producer blocked in write() is throttled by the depth.
+//
+// The modules see a plain sc_fifo through their ports.
+
+#define AXI_FIFO_DEPTH_MAX	1024
+
+template <typename T>
+class AXI_FIFO : public sc_core::sc_fifo<T>
+{
+public:
+	explicit AXI_FIFO(const char* name, int depth = 16)
+		: sc_core::sc_fifo<T>(name, depth), depth(depth)
+	{
+		if (depth < 1 || depth > AXI_FIFO_DEPTH_MAX)
+		{
+			SC_REPORT_FATAL("AXI_FIFO", ("Invalid depth " + std::to_string(depth)).c_str());
+		}
+		histogram.assign(depth + 1, 0);
+	}
+
+	// the other read() of sc_fifo calls this one
+	using sc_core::sc_fifo<T>::read;
+
+	void read(T& value) override
+	{
+		if (this->num_available() > 0)
+		{
+			sc_core::sc_fifo<T>::read(value);
+			return;
+		}
+		uint64_t stamp_begin = stamp_now();
+		sc_core::sc_fifo<T>::read(value);
+		count_read_blocked ++;
+		read_blocked_ns += stamp_now() - stamp_begin;
+	}
+
+	void write(const T& value) override
+	{
+		if (this->num_free() > 0)
+		{
+			sc_core::sc_fifo<T>::write(value);
+		}
+		else
+		{
+			uint64_t stamp_begin = stamp_now();
+			sc_core::sc_fifo<T>::write(value);
+			count_write_blocked ++;
+			write_blocked_ns += stamp_now() - stamp_begin;
+		}
+		record_occupancy();
+	}
+
+	bool nb_write(const T& value) override
+	{
+		if (!sc_core::sc_fifo<T>::nb_write(value))
+		{
+			count_write_refused ++;
+			return false;
+		}
+		record_occupancy();
+		return true;
+	}
+
+	// between the workloads of a batch, the fifo is empty
+	void soft_reset()
+	{
+		histogram.assign(depth + 1, 0);
+		count_write = 0;
+		count_write_refused = 0;
+		count_read_blocked = 0;
+		count_write_blocked = 0;
+		read_blocked_ns = 0;
+		write_blocked_ns = 0;
+		max_occupancy = 0;
+	}
+
+	void report_stats()
+	{
+		uint64_t sum_occupancy = 0;
+		for (int i = 0; i <= depth; i++)
+		{
+			sum_occupancy += histogram[i] * i;
+		}
+		std::cout << "FIFO " << this->name() << ": depth=" << depth
+			<< ", writes=" << count_write
+			<< ", max_occupancy=" << max_occupancy
+			<< ", avg_occupancy=" << (count_write ? (double) sum_occupancy / count_write : 0.0)
+			<< ", full=" << histogram[depth] << std::endl;
+		std::cout << "FIFO " << this->name() << ": blocked_reads=" << count_read_blocked
+			<< ", read_blocked=" << read_blocked_ns << " ns"
+			<< ", blocked_writes=" << count_write_blocked
+			<< ", write_blocked=" << write_blocked_ns << " ns"
+			<< ", refused_writes=" << count_write_refused << std::endl;
+
+		// occupancy after each write, the empty buckets left out
+		std::cout << "FIFO " << this->name() << ": occupancy";
+		for (int i = 1; i <= depth; i++)
+		{
+			if (histogram[i] > 0)
+			{
+				std::cout << " " << i << ":" << histogram[i];
+			}
+		}
+		std::cout << std::endl;
+	}
+
+	const int depth;
+
+	// statistics
+	std::vector<uint64_t> histogram;	// writes by the occupancy they leave
+	uint64_t count_write = 0;
+	uint64_t count_write_refused = 0;	// nb_write() into a full fifo
+	uint64_t count_read_blocked = 0;
+	uint64_t count_write_blocked = 0;
+	uint64_t read_blocked_ns = 0;
+	uint64_t write_blocked_ns = 0;
+	int max_occupancy = 0;
+
+private:
+	// num_free() counts the writes of this delta cycle as taken
+	void record_occupancy()
+	{
+		int occupancy = depth - this->num_free();
+		histogram[occupancy] ++;
+		count_write ++;
+		if (occupancy > max_occupancy)
+		{
+			max_occupancy = occupancy;
+		}
+	}
+
+	static uint64_t stamp_now()
+	{
+		return sc_core::sc_time_stamp().value() / 1000; // ps to ns convert.
+	}
+};
+
+#endif
@@ -0,0 +1,251 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cmath>
+#include <systemc>
+
+using namespace sc_core;
+using namespace sc_dt;
+
+#include "axi_latency.h"
+
+AXI_LATENCY_MODEL::AXI_LATENCY_MODEL()
+{
+	region_default.addr_start = 0;
+	region_default.addr_end = UINT64_MAX;
+	region_default.read_ns = LATENCY_DEFAULT_READ_NS;
+	region_default.write_ns = LATENCY_DEFAULT_WRITE_NS;
+	region_default.per_beat_ns = 0;
+	region_default.jitter = LATENCY_JITTER_NONE;
+	region_default.jitter_param = 0;
+	random_engine.seed(0);
+}
+
+void AXI_LATENCY_MODEL::clear()
+{
+	regions.clear();
+}
+
+void AXI_LATENCY_MODEL::set_seed(uint32_t seed)
+{
+	random_engine.seed(seed);
+}
+
+// state of the jitter generator, for checkpoints
+
+std::string AXI_LATENCY_MODEL::get_random_state() const
+{
+	std::ostringstream oss;
+	oss << random_engine;
+	return oss.str();
+}
+
+void AXI_LATENCY_MODEL::set_random_state(const std::string& state)
+{
+	std::istringstream iss(state);
+	iss >> random_engine;
+}
+
+bool AXI_LATENCY_MODEL::add_region(const latency_region_t& region)
+{
+	if (region.addr_end < region.addr_start)
+	{
+		std::cerr << "Error: latency region ends before it starts: "
+			<< region_to_string(region) << std::endl;
+		return false;
+	}
+
+	auto iter = std::upper_bound(regions.begin(), regions.end(), region.addr_start,
+		[](uint64_t addr, const latency_region_t& r) { return addr < r.addr_start; });
+
+	// the previous region must end before this one, the next must start after it.
+	if ((iter != regions.begin() && std::prev(iter)->addr_end >= region.addr_start)
+		|| (iter != regions.end() && iter->addr_start <= region.addr_end))
+	{
+		std::cerr << "Error: overlapping latency region: "
+			<< region_to_string(region) << std::endl;
+		return false;
+	}
+
+	regions.insert(iter, region);
+	return true;
+}
+
+const latency_region_t* AXI_LATENCY_MODEL::find_region(uint64_t addr) const
+{
+	// first region starting after addr, the one before it may cover addr.
+	auto iter = std::upper_bound(regions.begin(), regions.end(), addr,
+		[](uint64_t a, const latency_region_t& r) { return a < r.addr_start; });
+
+	if (iter == regions.begin())
+	{
+		return nullptr;
+	}
+	iter --;
+	if (addr > iter->addr_end)
+	{
+		return nullptr;
+	}
+	return &(*iter);
+}
+
+double AXI_LATENCY_MODEL::get_jitter_ns(const latency_region_t& region)
+{
+	if (region.jitter_param <= 0)
+	{
+		return 0;
+	}
+
+	switch (region.jitter)
+	{
+		case LATENCY_JITTER_UNIFORM:
+		{
+			std::uniform_real_distribution<double> dist(-region.jitter_param, region.jitter_param);
+			return dist(random_engine);
+		}
+		case LATENCY_JITTER_NORMAL:
+		{
+			std::normal_distribution<double> dist(0, region.jitter_param);
+			return dist(random_engine);
+		}
+		case LATENCY_JITTER_EXPONENTIAL:
+		{
+			std::exponential_distribution<double> dist(1.0 / region.jitter_param);
+			return dist(random_engine);
+		}
+		default:
+			return 0;
+	}
+}
+
+int AXI_LATENCY_MODEL::get_latency_ns(uint64_t addr, int length, bool is_write)
+{
+	const latency_region_t* region = find_region(addr);
+	if (region == nullptr)
+	{
+		region = &region_default;
+	}
+
+	double latency = is_write ? region->write_ns : region->read_ns;
+	latency += region->per_beat_ns * length;
+	latency += get_jitter_ns(*region);
+
+	if (latency < 0)
+	{
+		latency = 0;
+	}
+	// +0.5 is needed for rounding
+	return (int) (latency + 0.5);
+}
+
+int AXI_LATENCY_MODEL::jitter_from_string(const std::string& s)
+{
+	if (s == "none" || s.empty())	return LATENCY_JITTER_NONE;
+	if (s == "uniform")				return LATENCY_JITTER_UNIFORM;
+	if (s == "normal")				return LATENCY_JITTER_NORMAL;
+	if (s == "exponential")			return LATENCY_JITTER_EXPONENTIAL;
+	return -1;
+}
+
+std::string AXI_LATENCY_MODEL::region_to_string(const latency_region_t& region)
+{
+	std::string s;
+	s = "start=" + address_to_hex_string(region.addr_start)
+		+ ", end=" + address_to_hex_string(region.addr_end)
+		+ ", read=" + std::to_string(region.read_ns)
+		+ ", write=" + std::to_string(region.write_ns)
+		+ ", per_beat=" + std::to_string(region.per_beat_ns)
+		+ ", jitter=" + std::to_string(region.jitter)
+		+ "/" + std::to_string(region.jitter_param);
+	return s;
+}
+
+// a whole token, empty is 0 where the column is optional
+
+bool AXI_LATENCY_MODEL::number_from_string(const std::string& s, bool is_optional, double& value)
+{
+	if (s.empty())
+	{
+		value = 0;
+		return is_optional;
+	}
+
+	size_t pos = 0;
+	try
+	{
+		value = std::stod(s, &pos);
+	}
+	catch (const std::exception&)
+	{
+		return false;
+	}
+	return pos == s.size();
+}
+
+bool AXI_LATENCY_MODEL::read_csv(const std::string& filename)
+{
+	clear();
+
+	std::ifstream f(filename);
+	if (!f.is_open())
+	{
+		std::cerr << "Error: could not open " << filename << std::endl;
+		return false;
+	}
+
+	int line_number = 1;
+	std::string line;
+	while (std::getline(f, line))
+	{
+		// line format
+		// start, end, read_ns, write_ns, per_beat_ns, jitter, jitter_param
+		//
+		// start, end: hex string, inclusive address range of the region
+		// read_ns, write_ns: number, base latency of a transaction
+		// per_beat_ns: number, latency added for each data beat
+		// jitter: none, uniform, normal or exponential
+		// jitter_param: number, half width, sigma or mean of the jitter
+		//
+		// empty lines and lines starting with '#' are ignored.
+
+		if (line.empty() || line[0] == '#')
+		{
+			line_number ++;
+			continue;
+		}
+
+		std::istringstream iss(line);
+		std::string token[7];
+		for (int i = 0; i < 7; i++)
+		{
+			std::getline(iss, token[i], ',');
+			token[i].erase(0, token[i].find_first_not_of(" \t"));
+			token[i].erase(token[i].find_last_not_of(" \t\r") + 1);
+		}
+
+		latency_region_t region = {};
+		int jitter = jitter_from_string(token[5]);
+		region.addr_start = address_from_hex_string(token[0]);
+		region.addr_end = address_from_hex_string(token[1]);
+		region.jitter = jitter;
+		if (token[0].empty() || token[1].empty() || jitter < 0
+			|| !number_from_string(token[2], false, region.read_ns)
+			|| !number_from_string(token[3], false, region.write_ns)
+			|| !number_from_string(token[4], true, region.per_beat_ns)
+			|| !number_from_string(token[6], true, region.jitter_param))
+		{
+			std::cerr << "Error: invalid format in " << filename << std::endl;
+			std::cerr << "At line (" << line_number << "): " << line << std::endl;
+			SC_REPORT_FATAL("AXI_LATENCY_MODEL", "Invalid latency table");
+		}
+
+		if (!add_region(region))
+		{
+			std::cerr << "At line (" << line_number << "): " << line << std::endl;
+			SC_REPORT_FATAL("AXI_LATENCY_MODEL", "Invalid latency region");
+		}
+		line_number ++;
+	}
+	return true;
+}
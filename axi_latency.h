@@ -0,0 +1,64 @@
+#ifndef __AXI_LATENCY_H__
+#define __AXI_LATENCY_H__
+
+#include <string>
+#include <vector>
+#include <random>
+#include "axi_param.h"
+
+// jitter distribution of a latency region
+
+#define LATENCY_JITTER_NONE			0
+#define LATENCY_JITTER_UNIFORM		1	// uniform in [-param, +param]
+#define LATENCY_JITTER_NORMAL		2	// normal, sigma = param
+#define LATENCY_JITTER_EXPONENTIAL	3	// exponential, mean = param
+
+// latency used for the addresses not covered by any region
+#define LATENCY_DEFAULT_READ_NS		2
+#define LATENCY_DEFAULT_WRITE_NS	3
+
+typedef struct
+{
+	uint64_t	addr_start;		// inclusive
+	uint64_t	addr_end;		// inclusive
+	double		read_ns;		// base latency of a read transaction
+	double		write_ns;		// base latency of a write transaction
+	double		per_beat_ns;	// added for each data beat
+	int			jitter;			// LATENCY_JITTER_XXX
+	double		jitter_param;
+} latency_region_t;
+
+// Address-region latency model.
+// Regions are kept sorted by start address, and must not overlap,
+// so that a lookup is a binary search over the table.
+
+class AXI_LATENCY_MODEL
+{
+public:
+	AXI_LATENCY_MODEL();
+
+	bool read_csv(const std::string& filename);
+	bool add_region(const latency_region_t& region);
+	void clear();
+	void set_seed(uint32_t seed);
+	std::string get_random_state() const;
+	void set_random_state(const std::string& state);
+
+	const latency_region_t* find_region(uint64_t addr) const;
+	int get_latency_ns(uint64_t addr, int length, bool is_write);
+
+	size_t size() const { return regions.size(); }
+
+	static int jitter_from_string(const std::string& s);
+	static std::string region_to_string(const latency_region_t& region);
+
+private:
+	std::vector<latency_region_t> regions;
+	latency_region_t region_default;
+	std::mt19937 random_engine;
+
+	double get_jitter_ns(const latency_region_t& region);
+	static bool number_from_string(const std::string& s, bool is_optional, double& value);
+};
+
+#endif
@@ -1,4 +1,5 @@
 #include <iostream>
+#include <algorithm>
 #include <systemc>
 #include <fstream>
 #include <sstream>
@@ -11,6 +12,7 @@ using namespace sc_core;
 using namespace sc_dt;
 
 #include "axi_manager.h"
+#include "axi_checkpoint.h"
 
 void AXI_MANAGER::thread_sender()
 {
@@ -31,29 +33,42 @@ void AXI_MANAGER::thread_receiver()
 void AXI_MANAGER::fifo_receiver()
 {
 	std::string log_detail = "";
-	axi_trans_t trans;
 
-	trans = response.read();
-	if (trans.is_write == false)
-	{
-		uint64_t amount_addr_inc = DATA_WIDTH / 8;
-		// update memory
-		for (int i = 0; i < trans.length; i ++)
-		{
-			uint64_t addr = trans.addr + amount_addr_inc * i;
-			map_memory[addr] = trans.data[i];
-		}
-	}
+	axi_trans_handle_t handle = response.read();
+	const axi_trans_t& trans = *handle;
+	update_memory(trans);
 
 	log_detail = AXI_BUS::transaction_to_string(trans);
 	log(__FUNCTION__, "GOT RESPONSE", log_detail);
+
+	if (!split_coalesced(trans))
+	{
+		complete(trans);
+	}
+	axi_trans_free(handle);
+}
+
+// the read data of a response, only the byte lanes of each beat are valid
+
+void AXI_MANAGER::update_memory(const axi_trans_t& trans)
+{
+	if (trans.is_write)
+	{
+		return;
+	}
+	for (int i = 0; i < trans.length; i ++)
+	{
+		uint64_t addr_beat = axi_beat_address(trans.addr, trans.burst, trans.size, trans.length, i);
+		uint64_t addr = axi_word_address(addr_beat);
+		bus_strb_t strb = axi_beat_strobe(addr_beat, trans.size);
+		map_memory[addr] = bus_data_merge(map_memory[addr], trans.data[i], strb);
+	}
 }
 
 void AXI_MANAGER::fifo_sender()
 {
 	std::string log_action = CHANNEL_UNKNOWN;
 	std::string log_detail = "";
-	axi_trans_t trans;
 
 	// Are there requests to send?
 
@@ -62,16 +77,41 @@ void AXI_MANAGER::fifo_sender()
 		// No job to do.
 		log_action = "empty q";
 		log(__FUNCTION__, log_action, log_detail);
-		
-		// wait until end of simulation
-		wait(100, SC_SEC);
+
+		// wait until more accesses are read
+		wait(event_access_queued);
 		return;
 	}
 
-	// queue access tuple: (timestamp, transaction)
-	auto tuple = queue_access.front();
-	uint64_t stamp_q = std::get<0>(tuple);
-	trans = std::get<1>(tuple);
+	const access_t& access = queue_access.front();
+	uint64_t stamp_q = get_stamp_due(access.stamp);
+
+	if (is_held(access))
+	{
+		// the rest of the trace runs after the checkpoint
+		log(__FUNCTION__, "HOLD", "scheduled=" + std::to_string(stamp_q)
+			+ ", hold=" + std::to_string(stamp_hold_ns));
+		wait(event_release);
+		return;
+	}
+
+	if (sampler.get_phase(access.index) == SAMPLE_FUNCTIONAL)
+	{
+		if (count_issued != count_retired)
+		{
+			// the detailed phase drains first
+			wait(event_retired);
+			return;
+		}
+		if (is_downstream_idle && !is_downstream_idle())
+		{
+			// e.g. buffered writes, already answered
+			wait(1, SC_NS);
+			return;
+		}
+		fast_forward();
+		return;
+	}
 
 	// XXX Warning:
 	// sc_time_stamp().value() depends on the time resolution of the simulation.
@@ -94,10 +134,520 @@ void AXI_MANAGER::fifo_sender()
 		return;
 	}
 
-	request.write(trans);
-	log_detail = AXI_BUS::transaction_to_string(trans);
+	if (!is_issuable(access))
+	{
+		// wait until something retires
+		wait(event_retired);
+		return;
+	}
+
+	if (is_coalescing)
+	{
+		uint64_t stamp_youngest = access.stamp;
+		size_t count = collect_coalesced(stamp_youngest);
+		stamp_youngest = get_stamp_due(stamp_youngest);
+		if (count > 1)
+		{
+			if (stamp_youngest > stamp_now)
+			{
+				// hold the burst until its youngest access is due
+				log(__FUNCTION__, "COALESCE HOLD", "count=" + std::to_string(count));
+				wait(stamp_youngest - stamp_now, SC_NS);
+				return;
+			}
+			send_coalesced(count);
+			return;
+		}
+		if (is_coalesced_in_flight(access.trans))
+		{
+			// its response would be split as the coalesced burst's
+			log(__FUNCTION__, "COALESCE CONFLICT", AXI_BUS::transaction_to_string(access.trans));
+			wait(event_retired);
+			return;
+		}
+	}
+
+	issue(access);
+	axi_trans_write(request, access.trans);
+	count_requests_sent ++;
+	log_detail = AXI_BUS::transaction_to_string(access.trans);
 	log(__FUNCTION__, "SENT REQUEST", log_detail);
-	queue_access.pop();
+	queue_access.pop_front();
+}
+
+uint64_t AXI_MANAGER::get_stamp_due(uint64_t stamp) const
+{
+	return (stamp > stamp_skip_ns) ? stamp - stamp_skip_ns : 0;
+}
+
+// Apply the accesses of a functional phase in trace order, without
+// simulated time. Nothing is in flight, so the memory images are up to date.
+
+void AXI_MANAGER::fast_forward()
+{
+	uint64_t count = 0;
+
+	while (!queue_access.empty())
+	{
+		access_t& access = queue_access.front();
+		if (sampler.get_phase(access.index) != SAMPLE_FUNCTIONAL || is_held(access))
+		{
+			break;
+		}
+		functional_access(access.trans);
+		update_memory(access.trans);
+		is_retired[access.index] = true;
+		queue_access.pop_front();
+		count ++;
+	}
+	count_fast_forward += count;
+
+	// the next detailed phase is due now
+	uint64_t stamp_now = sc_time_stamp().value() / 1000; // ps to ns convert.
+	if (!queue_access.empty() && get_stamp_due(queue_access.front().stamp) > stamp_now)
+	{
+		stamp_skip_ns = queue_access.front().stamp - stamp_now;
+	}
+
+	log(__FUNCTION__, "FAST FORWARD", "count=" + std::to_string(count)
+		+ ", skip=" + std::to_string(stamp_skip_ns));
+}
+
+bool AXI_MANAGER::is_coalescable(const access_t& access)
+{
+	const axi_trans_t& trans = access.trans;
+	return trans.length == 1 && trans.burst == AXI_BURST_INCR && trans.size == AXI_SIZE_FULL
+		&& (trans.addr % BUS_BYTES) == 0;
+}
+
+// Count the accesses from the head of the queue that merge into one burst.
+// stamp_youngest returns the latest stamp among them.
+
+size_t AXI_MANAGER::collect_coalesced(uint64_t& stamp_youngest)
+{
+	const access_t& head = queue_access.front();
+	if (!is_coalescable(head))
+	{
+		return 1;
+	}
+
+	int outstanding = head.trans.is_write ? count_outstanding_write : count_outstanding_read;
+	int max_outstanding = head.trans.is_write ? max_outstanding_write : max_outstanding_read;
+	size_t count = 1;
+
+	while (count < queue_access.size() && count < AXI_TRANSACTION_LENGTH_MAX)
+	{
+		const access_t& next = queue_access[count];
+		uint64_t addr_next = head.trans.addr + count * BUS_BYTES;
+
+		if (!is_coalescable(next) || next.trans.is_write != head.trans.is_write
+			|| next.stream != head.stream || next.trans.addr != addr_next
+			|| (addr_next / 4096) != (head.trans.addr / 4096)
+			|| next.stamp > head.stamp + coalesce_window_ns
+			|| is_held(next)
+			|| sampler.get_phase(next.index) != sampler.get_phase(head.index))
+		{
+			break;
+		}
+		if (is_closed_loop)
+		{
+			if (max_outstanding > 0 && outstanding + (int) count >= max_outstanding)
+			{
+				break;
+			}
+			if (next.depend >= 0 && !is_retired[next.depend])
+			{
+				break;
+			}
+		}
+		stamp_youngest = std::max(stamp_youngest, next.stamp);
+		count ++;
+	}
+
+	// A response is taken for the coalesced burst by address, direction and
+	// length, so no real burst with the same ones may be in flight.
+	if (count > 1)
+	{
+		for (const auto& iter : map_inflight)
+		{
+			for (const inflight_t& inflight : iter.second)
+			{
+				if (!inflight.is_completed && inflight.addr == head.trans.addr
+					&& inflight.is_write == head.trans.is_write && inflight.length == count)
+				{
+					log(__FUNCTION__, "COALESCE CONFLICT", AXI_BUS::transaction_to_string(head.trans));
+					return 1;
+				}
+			}
+		}
+	}
+
+	return count;
+}
+
+bool AXI_MANAGER::is_coalesced_in_flight(const axi_trans_t& trans)
+{
+	return std::any_of(q_coalesced.begin(), q_coalesced.end(),
+		[&trans](const coalesced_t& c)
+		{
+			return c.addr == trans.addr && c.is_write == trans.is_write && c.length == trans.length;
+		});
+}
+
+void AXI_MANAGER::send_coalesced(size_t count)
+{
+	axi_trans_t trans = queue_access.front().trans;
+	trans.length = count;
+
+	for (size_t i = 0; i < count; i++)
+	{
+		const access_t& access = queue_access.front();
+		trans.data[i] = access.trans.data[0];
+		trans.strb[i] = access.trans.strb[0];
+		issue(access);
+		queue_access.pop_front();
+	}
+
+	q_coalesced.push_back(coalesced_t{trans.addr, trans.is_write, (uint16_t) count});
+	count_coalesced_burst ++;
+	count_coalesced_access += count;
+
+	axi_trans_write(request, trans);
+	count_requests_sent ++;
+	log(__FUNCTION__, "SENT COALESCED", AXI_BUS::transaction_to_string(trans));
+}
+
+// Complete each access of a coalesced burst.
+// Returns false when the response is not a coalesced burst.
+
+bool AXI_MANAGER::split_coalesced(const axi_trans_t& trans)
+{
+	auto iter = std::find_if(q_coalesced.begin(), q_coalesced.end(),
+		[&trans](const coalesced_t& c)
+		{
+			return c.addr == trans.addr && c.is_write == trans.is_write && c.length == trans.length;
+		});
+	if (iter == q_coalesced.end())
+	{
+		return false;
+	}
+	q_coalesced.erase(iter);
+
+	for (int i = 0; i < trans.length; i++)
+	{
+		axi_trans_t trans_split = trans;
+		trans_split.addr = trans.addr + i * BUS_BYTES;
+		trans_split.length = 1;
+		trans_split.data[0] = trans.data[i];
+		trans_split.strb[0] = trans.strb[i];
+		complete(trans_split);
+	}
+	return true;
+}
+
+bool AXI_MANAGER::is_issuable(const access_t& access)
+{
+	std::string log_detail;
+
+	if (!is_closed_loop)
+	{
+		return true;
+	}
+
+	log_detail = "index=" + std::to_string(access.index)
+		+ ", reads=" + std::to_string(count_outstanding_read)
+		+ ", writes=" + std::to_string(count_outstanding_write);
+
+	if (access.trans.is_write)
+	{
+		if (max_outstanding_write > 0 && count_outstanding_write >= max_outstanding_write)
+		{
+			count_stall_outstanding ++;
+			log(__FUNCTION__, "MAX OUTSTANDING", log_detail);
+			return false;
+		}
+	}
+	else
+	{
+		if (max_outstanding_read > 0 && count_outstanding_read >= max_outstanding_read)
+		{
+			count_stall_outstanding ++;
+			log(__FUNCTION__, "MAX OUTSTANDING", log_detail);
+			return false;
+		}
+	}
+
+	if (access.depend >= 0 && !is_retired[access.depend])
+	{
+		count_stall_depend ++;
+		log_detail += ", depend=" + std::to_string(access.depend);
+		log(__FUNCTION__, "DEPENDENCY", log_detail);
+		return false;
+	}
+
+	return true;
+}
+
+void AXI_MANAGER::issue(const access_t& access)
+{
+	uint64_t stamp_now = sc_time_stamp().value() / 1000; // ps to ns convert.
+
+	inflight_t inflight;
+	inflight.index = access.index;
+	inflight.addr = access.trans.addr;
+	inflight.is_write = access.trans.is_write;
+	inflight.length = access.trans.length;
+	inflight.size = access.trans.size;
+	inflight.stamp_issue = stamp_now;
+	inflight.is_completed = false;
+	map_inflight[access.stream].push_back(inflight);
+
+	if (access.trans.is_write)
+	{
+		count_outstanding_write ++;
+	}
+	else
+	{
+		count_outstanding_read ++;
+	}
+
+	if (count_issued == 0)
+	{
+		stamp_first_issue_ns = stamp_now;
+	}
+	count_issued ++;
+}
+
+// Mark the oldest matching transaction as completed.
+// The bus returns the transaction as it was sent, so address and
+// direction are enough to find it.
+
+void AXI_MANAGER::complete(const axi_trans_t& trans)
+{
+	inflight_t* oldest = nullptr;
+	uint32_t stream_oldest = 0;
+
+	for (auto& iter : map_inflight)
+	{
+		for (auto& inflight : iter.second)
+		{
+			if (inflight.is_completed || inflight.addr != trans.addr
+				|| inflight.is_write != trans.is_write)
+			{
+				continue;
+			}
+			if (oldest == nullptr || inflight.index < oldest->index)
+			{
+				oldest = &inflight;
+				stream_oldest = iter.first;
+			}
+			break;
+		}
+	}
+
+	if (oldest == nullptr)
+	{
+		log(__FUNCTION__, "NOT IN FLIGHT", AXI_BUS::transaction_to_string(trans));
+		SC_REPORT_FATAL("AXI_MANAGER", "Response without request");
+		return;
+	}
+
+	oldest->is_completed = true;
+	retire(stream_oldest);
+}
+
+// Retire completed transactions from the head of the stream.
+
+void AXI_MANAGER::retire(uint32_t stream)
+{
+	std::string log_detail;
+	uint64_t stamp_now = sc_time_stamp().value() / 1000; // ps to ns convert.
+	auto& q = map_inflight[stream];
+
+	while (!q.empty() && q.front().is_completed)
+	{
+		const inflight_t& inflight = q.front();
+		uint64_t latency = stamp_now - inflight.stamp_issue;
+
+		if (inflight.is_write)
+		{
+			count_outstanding_write --;
+		}
+		else
+		{
+			count_outstanding_read --;
+		}
+		is_retired[inflight.index] = true;
+
+		count_retired ++;
+		count_bytes += (uint64_t) inflight.length << inflight.size;
+		sampler.record(inflight.index, latency, (uint64_t) inflight.length << inflight.size,
+			inflight.stamp_issue, stamp_now);
+		sum_latency_ns += latency;
+		max_latency_ns = std::max(max_latency_ns, latency);
+		stamp_last_retire_ns = stamp_now;
+
+		log_detail = "index=" + std::to_string(inflight.index)
+			+ ", stream=" + std::to_string(stream)
+			+ ", latency=" + std::to_string(latency);
+		log(__FUNCTION__, "RETIRED", log_detail);
+
+		q.pop_front();
+		event_retired.notify(SC_ZERO_TIME);
+	}
+}
+
+void AXI_MANAGER::report_stats()
+{
+	uint64_t duration_ns = stamp_last_retire_ns - stamp_first_issue_ns;
+
+	std::cout << "MANAGER " << name() << ": issued=" << count_issued
+		<< ", retired=" << count_retired
+		<< ", stall_outstanding=" << count_stall_outstanding
+		<< ", stall_depend=" << count_stall_depend << std::endl;
+	if (count_retired > 0)
+	{
+		std::cout << "MANAGER " << name() << ": avg_latency="
+			<< (double) sum_latency_ns / count_retired << " ns"
+			<< ", max_latency=" << max_latency_ns << " ns"
+			<< ", bytes=" << count_bytes
+			<< ", bandwidth=" << (duration_ns ? (double) count_bytes / duration_ns : 0)
+			<< " bytes/ns" << std::endl;
+	}
+	if (sampler.is_enabled())
+	{
+		std::cout << "MANAGER " << name() << ": fast_forwarded=" << count_fast_forward
+			<< " of " << count_issued + count_fast_forward << " accesses" << std::endl;
+		sampler.report(name());
+	}
+	if (is_coalescing)
+	{
+		std::cout << "MANAGER " << name() << ": address_requests=" << count_requests_sent
+			<< " for " << count_issued << " accesses"
+			<< ", coalesced_bursts=" << count_coalesced_burst
+			<< ", coalesced_accesses=" << count_coalesced_access
+			<< ", reduction=" << (count_issued ? 100.0 * (count_issued - count_requests_sent) / count_issued : 0)
+			<< "%" << std::endl;
+	}
+}
+
+bool AXI_MANAGER::is_held(const access_t& access)
+{
+	return (stamp_hold_ns > 0 && access.stamp >= stamp_hold_ns);
+}
+
+void AXI_MANAGER::release()
+{
+	stamp_hold_ns = 0;
+	event_release.notify(SC_ZERO_TIME);
+}
+
+// The remaining trace and the memory image, once everything issued
+// before the hold has retired.
+
+void AXI_MANAGER::save_state(AXI_CHECKPOINT& checkpoint)
+{
+	if (count_issued != count_retired)
+	{
+		SC_REPORT_FATAL("AXI_MANAGER", "Checkpoint with transactions in flight");
+	}
+
+	checkpoint.put_tag("MANAGER:" + std::string(name()));
+	checkpoint.put_uint(is_retired.size());
+	for (bool retired : is_retired)
+	{
+		checkpoint.put_bool(retired);
+	}
+	checkpoint.put_uint(queue_access.size());
+	for (const access_t& access : queue_access)
+	{
+		checkpoint.put_uint(access.stamp);
+		checkpoint.put_uint(access.index);
+		checkpoint.put_uint(access.stream);
+		checkpoint.put_int(access.depend);
+		checkpoint.put_trans(access.trans);
+	}
+	checkpoint.put_memory(map_memory);
+}
+
+void AXI_MANAGER::restore_state(AXI_CHECKPOINT& checkpoint)
+{
+	checkpoint.expect_tag("MANAGER:" + std::string(name()));
+	is_retired.assign(checkpoint.get_uint(), false);
+	for (size_t i = 0; i < is_retired.size(); i++)
+	{
+		is_retired[i] = checkpoint.get_bool();
+	}
+	queue_access.clear();
+	uint64_t count = checkpoint.get_uint();
+	for (uint64_t i = 0; i < count; i++)
+	{
+		access_t access;
+		access.stamp = checkpoint.shift_stamp(checkpoint.get_uint());
+		access.index = checkpoint.get_uint();
+		access.stream = checkpoint.get_uint();
+		access.depend = checkpoint.get_int();
+		access.trans = checkpoint.get_trans();
+		queue_access.push_back(access);
+	}
+	checkpoint.get_memory(map_memory);
+	event_access_queued.notify(SC_ZERO_TIME);
+}
+
+// Back to the state after elaboration, between the workloads of a batch.
+// Only called while the simulation is paused with all traffic drained.
+
+void AXI_MANAGER::soft_reset()
+{
+	queue_access.clear();
+	map_inflight.clear();
+	is_retired.clear();
+	q_coalesced.clear();
+	map_memory.clear();
+	count_outstanding_read = 0;
+	count_outstanding_write = 0;
+
+	count_issued = 0;
+	count_retired = 0;
+	count_stall_outstanding = 0;
+	count_stall_depend = 0;
+	sum_latency_ns = 0;
+	max_latency_ns = 0;
+	count_bytes = 0;
+	stamp_first_issue_ns = 0;
+	stamp_last_retire_ns = 0;
+	count_requests_sent = 0;
+	count_coalesced_burst = 0;
+	count_coalesced_access = 0;
+	sampler.clear();
+	stamp_skip_ns = 0;
+	count_fast_forward = 0;
+}
+
+// All accesses are issued and retired, or held for a checkpoint.
+
+bool AXI_MANAGER::is_idle()
+{
+	return (queue_access.empty() || is_held(queue_access.front()))
+		&& count_retired == count_issued;
+}
+
+void AXI_MANAGER::report_outstanding()
+{
+	std::cout << "MANAGER " << name() << ": queued=" << queue_access.size()
+		<< ", in_flight=" << (count_issued - count_retired) << std::endl;
+	for (auto& iter : map_inflight)
+	{
+		for (auto& inflight : iter.second)
+		{
+			std::cout << "MANAGER " << name() << ":   index=" << inflight.index
+				<< ", stream=" << iter.first
+				<< ", " << (inflight.is_write ? "W" : "R")
+				<< ", addr=" << address_to_hex_string(inflight.addr)
+				<< ", completed=" << inflight.is_completed
+				<< ", issued=" << inflight.stamp_issue << " ns" << std::endl;
+		}
+	}
 }
 
 void AXI_MANAGER::log(std::string source, std::string action, std::string detail)
@@ -111,7 +661,7 @@ void AXI_MANAGER::read_access_csv()
 {
 	while (!queue_access.empty())
 	{
-		queue_access.pop();
+		queue_access.pop_front();
 	}
 
 	std::ifstream f(filename_access);
@@ -121,11 +671,16 @@ void AXI_MANAGER::read_access_csv()
 		return;
 	}
 
-	axi_trans_t trans_current;
+	// the stamps of the trace count from the time it is read,
+	// so that the workloads of a batch run one after the other.
+	uint64_t stamp_base = sc_time_stamp().value() / 1000; // ps to ns convert.
+
+	access_t access_current;
+	axi_trans_t& trans_current = access_current.trans;
 	uint64_t stamp_current;
 	bool is_expecting_new = true;
 	int count_data = 0;
-	std::tuple<uint64_t, axi_trans_t> row;
+	uint32_t count_access = 0;
 
 	int line_number = 1;
 	std::string line;
@@ -136,24 +691,46 @@ void AXI_MANAGER::read_access_csv()
 		char rw;
 		bool is_write;
 		uint64_t address;
-		uint8_t length;
+		uint64_t length;
 		bus_data_t data;
-		std::string token1, token2, token3, token4, token5;
+		std::string token1, token2, token3, token4, token5, token6, token7;
+		std::string token8, token9, token10;
+		int burst = AXI_BURST_INCR;
+		uint64_t size = AXI_SIZE_FULL;
+		uint32_t stream;
+		int64_t depend;
 
 		// line format
-		// stamp, R/W, address, length, data
+		// stamp, R/W, address, length, data[, stream[, depend[, burst[, size[, strb]]]]]
 		//
 		// stamp: integer, simulation time in nano second
 		// R/W: character, 'R' or 'W', to indicate read or write action
 		// address: hex string, ADDR_WIDTH bit, address to read or write
 		// length: integer, how many data to transfer at one transaction
 		// data: hex string, DATA_WIDTH bit, data to transfer
+		// stream: integer, optional, ordering stream (default 0), the
+		//         transactions of a stream retire in order. It is not the
+		//         issued AXI ID, the bus assigns its own IDs.
+		// depend: integer, optional, index of the transaction
+		//         which must complete before this one is issued
+		//         (closed loop only, default -1 for none)
+		// burst: optional, FIXED, INCR or WRAP (default INCR)
+		// size: integer, optional, log2 of bytes in a beat (default full width)
+		// strb: hex string, optional, byte lanes written by this beat
+		//       (default the lanes of the beat address and size)
+		//
+		// data is the whole bus word, with the bytes on their lanes.
 
 		std::getline(iss, token1, ',');
 		std::getline(iss, token2, ',');
 		std::getline(iss, token3, ',');
 		std::getline(iss, token4, ',');
 		std::getline(iss, token5, ',');
+		std::getline(iss, token6, ',');
+		std::getline(iss, token7, ',');
+		std::getline(iss, token8, ',');
+		std::getline(iss, token9, ',');
+		std::getline(iss, token10, ',');
 		if (token1.empty() || token2.empty() || token3.empty() || token4.empty() || token5.empty())
 		{
 			std::cerr << "Error: invalid format in " << filename_access << std::endl;
@@ -166,6 +743,16 @@ void AXI_MANAGER::read_access_csv()
 		address = std::stoull(token3, nullptr, 16);
 		length = std::stoul(token4);
 		data = token5.c_str();
+		if (!token8.empty())
+		{
+			burst = axi_burst_from_string(token8);
+		}
+		if (!token9.empty())
+		{
+			size = std::stoull(token9);
+		}
+		stream = token6.empty() ? 0 : std::stoul(token6);
+		depend = token7.empty() ? -1 : std::stoll(token7);
 
 		if (rw == BUS_ACCESS_WRITE)
 		{
@@ -183,18 +770,42 @@ void AXI_MANAGER::read_access_csv()
 
 		if(is_expecting_new)
 		{
+			// before the beats use them
+			if (length > AXI_TRANSACTION_LENGTH_MAX)
+			{
+				std::cerr << "Error: too long access length " << std::to_string(length)
+					<< " (max=" << AXI_TRANSACTION_LENGTH_MAX << ") in " << filename_access
+					<< ", at line (" << line_number << "): " << line << std::endl;
+				SC_REPORT_FATAL("AXI_MANAGER", "Too long access length");
+			}
+			if (burst < 0 || size > AXI_SIZE_FULL || !axi_burst_is_valid(address, burst, size, length))
+			{
+				std::cerr << "Error: invalid burst in " << filename_access
+					<< ", at line (" << line_number << "): " << line << std::endl;
+				SC_REPORT_FATAL("AXI_MANAGER", "Invalid burst");
+			}
+
 			trans_current.addr = address;
 			trans_current.length = length;
+			trans_current.burst = burst;
+			trans_current.size = size;
 			trans_current.data[0] = data;
 			trans_current.is_write = is_write;
+			access_current.index = count_access;
+			access_current.stream = stream;
+			access_current.depend = depend;
+			if (access_current.depend >= (int64_t) count_access)
+			{
+				std::cerr << "Error: dependency on a later transaction in " << filename_access
+					<< ", at line (" << line_number << "): " << line << std::endl;
+				SC_REPORT_FATAL("AXI_MANAGER", "Invalid dependency");
+			}
 			count_data = 1;
 			stamp_current = stamp;
 			is_expecting_new = false;
 		}
 		else	// expecting more data
 		{
-			trans_current.data[count_data] = data;
-			count_data ++;
 			if ((length != trans_current.length) | (stamp != stamp_current))
 			{
 				// This must not happen
@@ -202,27 +813,47 @@ void AXI_MANAGER::read_access_csv()
 					<< ", at line (" << line_number << "): " << line << std::endl;
 				SC_REPORT_FATAL("AXI_MANAGER", "Invalid access length");
 			}
+			// the beats of a burst share its attributes
+			if (is_write != trans_current.is_write || burst != trans_current.burst
+				|| size != trans_current.size || stream != access_current.stream
+				|| depend != access_current.depend)
+			{
+				std::cerr << "Error: beat differs from the first line of its burst in "
+					<< filename_access << ", at line (" << line_number << "): " << line << std::endl;
+				SC_REPORT_FATAL("AXI_MANAGER", "Invalid burst");
+			}
+			trans_current.data[count_data] = data;
+			count_data ++;
 		}
 
-		if (length >= AXI_TRANSACTION_LENGTH_MAX)
+		// byte lanes of this beat
+		int beat = count_data - 1;
+		if (token10.empty())
 		{
-			std::cerr << "Error: too long access length " << std::to_string(length)
-				<< " (max=" << AXI_TRANSACTION_LENGTH_MAX << ") in " << filename_access
-				<< ", at line (" << line_number << "): " << line << std::endl;
-			SC_REPORT_FATAL("AXI_MANAGER", "Too long access length");
+			uint64_t addr_beat = axi_beat_address(trans_current.addr, trans_current.burst,
+				trans_current.size, trans_current.length, beat);
+			trans_current.strb[beat] = axi_beat_strobe(addr_beat, trans_current.size);
+		}
+		else
+		{
+			trans_current.strb[beat] = std::stoull(token10, nullptr, 16) & BUS_STRB_FULL;
 		}
 
-		if (count_data == length)
+		if ((uint64_t) count_data == length)
 		{
-			row = std::make_tuple(stamp_current, trans_current);
-			queue_access.push(row);
+			access_current.stamp = stamp_base + stamp_current;
+			queue_access.push_back(access_current);
+			count_access ++;
 			is_expecting_new = true;
 		}
 		line_number ++;
 	}
+
+	is_retired.assign(count_access, false);
+	event_access_queued.notify(SC_ZERO_TIME);
 }
 
-void AXI_MANAGER::write_memory_csv(const char* filename)
+void AXI_MANAGER::write_memory_csv(const std::string& filename)
 {
 	std::ofstream f(filename);
 	if (!f.is_open())
@@ -1,25 +1,121 @@
+#ifndef __AXI_MANAGER_H__
+#define __AXI_MANAGER_H__
+
 #include <systemc>
 #include <fstream>
 #include <queue>
+#include <deque>
+#include <map>
 #include <sstream>
 #include <vector>
 #include <string>
+#include <functional>
 
 #include "axi_param.h"
 #include "axi_bus.h"
+#include "axi_sampler.h"
+
+class AXI_CHECKPOINT;
+
+// one transaction of the access trace
+typedef struct
+{
+	uint64_t	stamp;		// earliest time to issue, in nano seconds
+	uint32_t	index;		// order in the trace, from 0
+	uint32_t	stream;		// ordering stream, retires in order
+	int64_t		depend;		// index of the access to complete first, -1 for none
+	axi_trans_t	trans;
+} access_t;
+
+// an issued transaction waiting for its response
+typedef struct
+{
+	uint32_t	index;
+	uint64_t	addr;
+	bool		is_write;
+	uint16_t	length;
+	uint8_t		size;
+	uint64_t	stamp_issue;
+	bool		is_completed;
+} inflight_t;
+
+// a burst merged from single-beat accesses, split again at the response
+typedef struct
+{
+	uint64_t	addr;
+	bool		is_write;
+	uint16_t	length;		// number of accesses merged
+} coalesced_t;
 
 SC_MODULE(AXI_MANAGER)
 {
-	sc_fifo_out<axi_trans_t> request;
-	sc_fifo_in<axi_trans_t> response;
+	sc_fifo_out<axi_trans_handle_t> request;
+	sc_fifo_in<axi_trans_handle_t> response;
 
-	const char *filename_access = "m_access.csv";
+	std::string filename_access = "m_access.csv";
 
 	// pair<address, data>
 	std::unordered_map<uint64_t, bus_data_t> map_memory;
 
-	// queue access tuple: (timestamp, access_type(r/w), address, length, data)
-	std::queue<std::tuple<uint64_t, axi_trans_t>> queue_access;
+	std::deque<access_t> queue_access;
+
+	// Closed loop: the next access is issued only when the outstanding
+	// transactions are below the limit, and its dependency has completed.
+	// Open loop: accesses are issued at the time stamp of the trace.
+	bool is_closed_loop = false;
+	int max_outstanding_read = 0;	// 0 is unlimited
+	int max_outstanding_write = 0;	// 0 is unlimited
+
+	// issued transactions of each stream, in issue order.
+	// A response completes its transaction, and it retires
+	// when all older transactions of the stream are retired.
+	// The in-order completion of an AXI ID is modelled here, in the
+	// manager: the bus allocates a free ID for every transaction and
+	// tracks one transaction per ID, so the stream never reaches AxID.
+	std::map<uint32_t, std::deque<inflight_t>> map_inflight;
+	std::vector<bool> is_retired;	// indexed by access index
+	int count_outstanding_read = 0;
+	int count_outstanding_write = 0;
+	sc_event event_retired;
+	sc_event event_access_queued;
+
+	// Coalescing: single-beat full-width INCR accesses of the same stream
+	// and direction at contiguous addresses, with stamps within the window
+	// of the first one, are sent as one INCR burst. The burst is sent when
+	// its youngest access is due, and never crosses a 4KiB boundary.
+	bool is_coalescing = false;
+	int coalesce_window_ns = 0;
+	std::deque<coalesced_t> q_coalesced;
+
+	// Checkpoint: accesses due at or after stamp_hold_ns are not issued
+	// until release(), so that the model drains. 0 is no hold.
+	uint64_t stamp_hold_ns = 0;
+	sc_event event_release;
+
+	// Sampling: the accesses of the functional phases are applied at once
+	// by functional_access, after the detailed ones before them retired
+	// and is_downstream_idle tells that nothing is left in a buffer below.
+	// The stamps of the trace after a fast-forward are moved earlier by
+	// stamp_skip_ns, so that the next detailed phase starts right away.
+	AXI_SAMPLER sampler;
+	std::function<void(axi_trans_t&)> functional_access;
+	std::function<bool()> is_downstream_idle;
+	uint64_t stamp_skip_ns = 0;
+	uint64_t count_fast_forward = 0;
+
+	// statistics
+	uint64_t count_issued = 0;
+	uint64_t count_retired = 0;
+	uint64_t count_stall_outstanding = 0;
+	uint64_t count_stall_depend = 0;
+	uint64_t sum_latency_ns = 0;
+	uint64_t max_latency_ns = 0;
+	uint64_t count_bytes = 0;
+	uint64_t stamp_first_issue_ns = 0;
+	uint64_t stamp_last_retire_ns = 0;
+	uint64_t count_requests_sent = 0;	// on the address channels
+	uint64_t count_coalesced_burst = 0;
+	uint64_t count_coalesced_access = 0;
 
 	SC_CTOR(AXI_MANAGER)
 	{
@@ -32,10 +128,33 @@ SC_MODULE(AXI_MANAGER)
 	void fifo_sender();
 	void fifo_receiver();
 
+	bool is_issuable(const access_t& access);
+	uint64_t get_stamp_due(uint64_t stamp) const;
+	void fast_forward();
+	void update_memory(const axi_trans_t& trans);
+	bool is_coalescable(const access_t& access);
+	size_t collect_coalesced(uint64_t& stamp_youngest);
+	void send_coalesced(size_t count);
+	bool split_coalesced(const axi_trans_t& trans);
+	bool is_coalesced_in_flight(const axi_trans_t& trans);
+	void issue(const access_t& access);
+	void complete(const axi_trans_t& trans);
+	void retire(uint32_t stream);
+	void report_stats();
+	void soft_reset();
+	bool is_held(const access_t& access);
+	void release();
+	void save_state(AXI_CHECKPOINT& checkpoint);
+	void restore_state(AXI_CHECKPOINT& checkpoint);
+	bool is_idle();
+	void report_outstanding();
+
 	void log(std::string source, std::string action, std::string detail);
 
 	uint32_t generate_transaction_id();
 
 	void read_access_csv();
-	void write_memory_csv(const char* filename="m_memory_after.csv");
+	void write_memory_csv(const std::string& filename="m_memory_after.csv");
 };
+
+#endif
@@ -35,3 +35,128 @@ std::string bus_data_to_hex_string(const bus_data_t& data)
 	ss << std::setfill('0') << std::setw(DATA_WIDTH / 4) << data.to_string(sc_dt::SC_HEX);
 	return ss.str();
 }
+
+std::string bus_strb_to_hex_string(bus_strb_t strb)
+{
+	std::stringstream ss;
+	ss << std::setfill('0') << std::setw(BUS_BYTES / 4) << std::hex << strb;
+	return ss.str();
+}
+
+// Chapter A3.4.2 address of the beat in a burst
+
+uint64_t axi_beat_address(uint64_t addr, uint8_t burst, uint8_t size, int length, int beat)
+{
+	uint64_t bytes = 1ULL << size;
+	uint64_t addr_aligned = (addr / bytes) * bytes;
+
+	switch (burst)
+	{
+		case AXI_BURST_FIXED:
+			return addr;
+		case AXI_BURST_WRAP:
+		{
+			uint64_t wrap_size = bytes * length;
+			uint64_t wrap_boundary = (addr / wrap_size) * wrap_size;
+			uint64_t offset = (addr_aligned - wrap_boundary + bytes * beat) % wrap_size;
+			return wrap_boundary + offset;
+		}
+		case AXI_BURST_INCR:
+		default:
+			if (beat == 0)
+			{
+				return addr;
+			}
+			return addr_aligned + bytes * beat;
+	}
+}
+
+// address of the bus word holding the byte at addr
+
+uint64_t axi_word_address(uint64_t addr)
+{
+	return addr & ~((uint64_t) BUS_BYTES - 1);
+}
+
+// byte lanes used by a beat, from the beat address up to
+// the end of the beat size
+
+bus_strb_t axi_beat_strobe(uint64_t beat_addr, uint8_t size)
+{
+	uint64_t bytes = 1ULL << size;
+	int lane_lower = beat_addr % BUS_BYTES;
+	int lane_upper = ((beat_addr / bytes) * bytes) % BUS_BYTES + bytes - 1;
+
+	bus_strb_t strb = 0;
+	for (int lane = lane_lower; lane <= lane_upper; lane++)
+	{
+		strb |= (bus_strb_t) 1 << lane;
+	}
+	return strb;
+}
+
+// replace the byte lanes of old selected by strb with those of data
+
+bus_data_t bus_data_merge(const bus_data_t& old, const bus_data_t& data, bus_strb_t strb)
+{
+	if (strb == BUS_STRB_FULL)
+	{
+		return data;
+	}
+
+	bus_data_t merged = old;
+	for (int lane = 0; lane < BUS_BYTES; lane++)
+	{
+		if ((strb >> lane) & 1)
+		{
+			merged.range(lane * 8 + 7, lane * 8) = data.range(lane * 8 + 7, lane * 8);
+		}
+	}
+	return merged;
+}
+
+// Chapter A3.4.1 restrictions on size and wrapping bursts
+
+bool axi_burst_is_valid(uint64_t addr, uint8_t burst, uint8_t size, int length)
+{
+	if (size > AXI_SIZE_FULL || length < 1 || length > AXI_TRANSACTION_LENGTH_MAX)
+	{
+		return false;
+	}
+
+	switch (burst)
+	{
+		case AXI_BURST_FIXED:
+			return (length <= 16);
+		case AXI_BURST_INCR:
+			return true;
+		case AXI_BURST_WRAP:
+			if (length != 2 && length != 4 && length != 8 && length != 16)
+			{
+				return false;
+			}
+			// the start address must be aligned to the size of the transfer
+			return ((addr % (1ULL << size)) == 0);
+		default:
+			return false;
+	}
+}
+
+int axi_burst_from_string(const std::string& s)
+{
+	if (s == "FIXED")	return AXI_BURST_FIXED;
+	if (s == "INCR")	return AXI_BURST_INCR;
+	if (s == "WRAP")	return AXI_BURST_WRAP;
+	return -1;
+}
+
+std::string axi_burst_to_string(uint8_t burst)
+{
+	switch (burst)
+	{
+		case AXI_BURST_FIXED:	return "FIXED";
+		case AXI_BURST_INCR:	return "INCR";
+		case AXI_BURST_WRAP:	return "WRAP";
+		default:				return "XXX";
+	}
+}
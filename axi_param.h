@@ -12,6 +12,23 @@
 
 typedef sc_dt::sc_bigint<DATA_WIDTH> bus_data_t;
 
+// Chapter A3.4.3 write strobes, one bit per byte lane
+typedef uint64_t bus_strb_t;
+#define BUS_BYTES		(DATA_WIDTH / 8)
+#define BUS_STRB_FULL	((bus_strb_t) (~0ULL >> (64 - BUS_BYTES)))
+
+// Chapter A3.4.1 burst type, AxBURST
+#define AXI_BURST_FIXED	0
+#define AXI_BURST_INCR	1
+#define AXI_BURST_WRAP	2
+
+// Chapter A3.4.1 burst size, AxSIZE is log2 of bytes in a beat
+constexpr int axi_size_from_bytes(int bytes)
+{
+	return (bytes <= 1) ? 0 : 1 + axi_size_from_bytes(bytes / 2);
+}
+#define AXI_SIZE_FULL	axi_size_from_bytes(BUS_BYTES)
+
 // Maximum number of data with one address
 // AxLEN width is 8 bits, so biggest possible is 256
 #define AXI_TRANSACTION_LENGTH_MAX	256
@@ -22,9 +39,11 @@ typedef sc_dt::sc_bigint<DATA_WIDTH> bus_data_t;
 #define CHANNEL_B		3
 #define CHANNEL_AR		4
 #define CHANNEL_R		5
+#define CHANNEL_COUNT	6	// for arrays indexed by channel id
 
 // name of channel states
 
+#define CHANNEL_FULL		"FULL"	// not ready, downstream is full
 #define CHANNEL_HOLD		"HOLD"
 #define CHANNEL_IDLE		"IDLE"
 #define CHANNEL_NOT_READY	"NOTREADY"
@@ -36,11 +55,22 @@ typedef sc_dt::sc_bigint<DATA_WIDTH> bus_data_t;
 #define CHANNEL_WAITR		"WAITR"	// wait for READY
 #define CHANNEL_WAITV		"WAITV"	// wait for VALID
 
+// burst utility functions
+
+uint64_t axi_beat_address(uint64_t addr, uint8_t burst, uint8_t size, int length, int beat);
+uint64_t axi_word_address(uint64_t addr);
+bus_strb_t axi_beat_strobe(uint64_t beat_addr, uint8_t size);
+bus_data_t bus_data_merge(const bus_data_t& old, const bus_data_t& data, bus_strb_t strb);
+bool axi_burst_is_valid(uint64_t addr, uint8_t burst, uint8_t size, int length);
+int axi_burst_from_string(const std::string& str);
+std::string axi_burst_to_string(uint8_t burst);
+
 // conversion utility functions
 
 uint64_t address_from_hex_string(const std::string& str);
 std::string address_to_hex_string(uint64_t address);
 bus_data_t bus_data_from_hex_string(const std::string& str);
 std::string bus_data_to_hex_string(const bus_data_t& data);
+std::string bus_strb_to_hex_string(bus_strb_t strb);
 
 #endif
@@ -0,0 +1,623 @@
+#include <iostream>
+#include <systemc>
+#include <string>
+#include <algorithm>
+
+using namespace sc_core;
+using namespace sc_dt;
+
+#include "axi_prefetcher.h"
+#include "axi_checkpoint.h"
+
+void PREFETCH_NEXT_LINE::observe(uint64_t block_addr, bool is_hit, std::vector<uint64_t>& candidates)
+{
+	for (int i = 1; i <= degree; i++)
+	{
+		candidates.push_back(block_addr + (uint64_t) block_bytes * i);
+	}
+}
+
+void PREFETCH_STRIDE::observe(uint64_t block_addr, bool is_hit, std::vector<uint64_t>& candidates)
+{
+	uint64_t region = block_addr / region_bytes;
+	auto iter = map_region.find(region);
+
+	if (iter == map_region.end())
+	{
+		map_region[region] = stride_entry_t{block_addr, 0, 0};
+		return;
+	}
+
+	stride_entry_t& entry = iter->second;
+	int64_t stride = (int64_t) (block_addr - entry.addr_last);
+	if (stride == 0)
+	{
+		return;
+	}
+
+	if (stride == entry.stride)
+	{
+		entry.confidence = std::min(entry.confidence + 1, confidence_min);
+	}
+	else
+	{
+		entry.stride = stride;
+		entry.confidence = 0;
+	}
+	entry.addr_last = block_addr;
+
+	if (entry.confidence < confidence_min)
+	{
+		return;
+	}
+	for (int i = 1; i <= degree; i++)
+	{
+		candidates.push_back(block_addr + entry.stride * i);
+	}
+}
+
+void PREFETCH_STRIDE::save_state(AXI_CHECKPOINT& checkpoint)
+{
+	checkpoint.put_uint(map_region.size());
+	for (const auto& iter : map_region)
+	{
+		checkpoint.put_uint(iter.first);
+		checkpoint.put_uint(iter.second.addr_last);
+		checkpoint.put_int(iter.second.stride);
+		checkpoint.put_int(iter.second.confidence);
+	}
+}
+
+void PREFETCH_STRIDE::restore_state(AXI_CHECKPOINT& checkpoint)
+{
+	map_region.clear();
+	uint64_t count = checkpoint.get_uint();
+	for (uint64_t i = 0; i < count; i++)
+	{
+		uint64_t region = checkpoint.get_uint();
+		stride_entry_t& entry = map_region[region];
+		entry.addr_last = checkpoint.get_uint();
+		entry.stride = checkpoint.get_int();
+		entry.confidence = checkpoint.get_int();
+	}
+}
+
+void PREFETCH_STREAM::observe(uint64_t block_addr, bool is_hit, std::vector<uint64_t>& candidates)
+{
+	stamp_access ++;
+
+	// a read at the head of a stream moves the stream one block ahead
+	for (stream_t& stream : streams)
+	{
+		if (block_addr != stream.addr_next)
+		{
+			continue;
+		}
+		stream.addr_next += block_bytes;
+		stream.stamp_used = stamp_access;
+		candidates.push_back(stream.addr_next + (uint64_t) block_bytes * (stream.count_ahead - 1));
+		return;
+	}
+
+	if (is_hit)
+	{
+		return;
+	}
+
+	// a miss allocates a new stream, replacing the least recently used one
+	stream_t stream_new = {block_addr + block_bytes, depth, stamp_access};
+	if ((int) streams.size() < count_stream)
+	{
+		streams.push_back(stream_new);
+	}
+	else
+	{
+		auto iter = std::min_element(streams.begin(), streams.end(),
+			[](const stream_t& a, const stream_t& b) { return a.stamp_used < b.stamp_used; });
+		*iter = stream_new;
+	}
+
+	for (int i = 0; i < depth; i++)
+	{
+		candidates.push_back(block_addr + (uint64_t) block_bytes * (i + 1));
+	}
+}
+
+void PREFETCH_STREAM::save_state(AXI_CHECKPOINT& checkpoint)
+{
+	checkpoint.put_uint(stamp_access);
+	checkpoint.put_uint(streams.size());
+	for (const stream_t& stream : streams)
+	{
+		checkpoint.put_uint(stream.addr_next);
+		checkpoint.put_int(stream.count_ahead);
+		checkpoint.put_uint(stream.stamp_used);
+	}
+}
+
+void PREFETCH_STREAM::restore_state(AXI_CHECKPOINT& checkpoint)
+{
+	stamp_access = checkpoint.get_uint();
+	streams.resize(checkpoint.get_uint());
+	for (stream_t& stream : streams)
+	{
+		stream.addr_next = checkpoint.get_uint();
+		stream.count_ahead = checkpoint.get_int();
+		stream.stamp_used = checkpoint.get_uint();
+	}
+}
+
+void AXI_PREFETCHER::end_of_elaboration()
+{
+	if (block_bytes < BUS_BYTES || block_bytes % BUS_BYTES != 0
+		|| block_bytes / BUS_BYTES > AXI_TRANSACTION_LENGTH_MAX
+		|| (block_bytes & (block_bytes - 1)) != 0)
+	{
+		SC_REPORT_FATAL("AXI_PREFETCHER", ("Invalid block size " + std::to_string(block_bytes)).c_str());
+	}
+	if (depth_buffer < 1 || max_prefetch_outstanding < 1)
+	{
+		SC_REPORT_FATAL("AXI_PREFETCHER", "Invalid buffer depth or outstanding limit");
+	}
+	if (engine != nullptr)
+	{
+		engine->block_bytes = block_bytes;
+	}
+}
+
+void AXI_PREFETCHER::thread_request()
+{
+	while(true)
+	{
+		fifo_request();
+	}
+}
+
+void AXI_PREFETCHER::thread_response()
+{
+	while(true)
+	{
+		fifo_response();
+	}
+}
+
+uint64_t AXI_PREFETCHER::get_block_address(uint64_t addr) const
+{
+	return addr & ~((uint64_t) block_bytes - 1);
+}
+
+std::vector<uint64_t> AXI_PREFETCHER::get_blocks(const axi_trans_t& trans) const
+{
+	std::vector<uint64_t> blocks;
+
+	for (int i = 0; i < trans.length; i++)
+	{
+		uint64_t addr_beat = axi_beat_address(trans.addr, trans.burst, trans.size, trans.length, i);
+		uint64_t block_addr = get_block_address(addr_beat);
+		if (std::find(blocks.begin(), blocks.end(), block_addr) == blocks.end())
+		{
+			blocks.push_back(block_addr);
+		}
+	}
+	return blocks;
+}
+
+void AXI_PREFETCHER::send_request(axi_trans_handle_t trans, bool is_prefetch)
+{
+	q_pending.push_back(prefetch_pending_t{trans->addr, trans->length, trans->is_write, is_prefetch});
+	request_out.write(trans);
+	log(__FUNCTION__, is_prefetch ? "SENT_PREFETCH" : "SENT_REQUEST", AXI_BUS::transaction_to_string(*trans));
+}
+
+// Answer the demand read from the buffer, if every block it needs
+// is there. Waits for blocks still in flight.
+
+bool AXI_PREFETCHER::serve_from_buffer(axi_trans_t& trans)
+{
+	std::vector<uint64_t> blocks = get_blocks(trans);
+	bool is_late = false;
+
+	for (uint64_t block_addr : blocks)
+	{
+		auto iter = map_block.find(block_addr);
+		if (iter == map_block.end() || iter->second.is_stale)
+		{
+			return false;
+		}
+		is_late |= !iter->second.is_ready;
+	}
+
+	if (is_late)
+	{
+		count_late_hit ++;
+		log(__FUNCTION__, "LATE_HIT", AXI_BUS::transaction_to_string(trans));
+		// wait until the blocks are in, or gone
+		while (true)
+		{
+			bool is_all_ready = true;
+			for (uint64_t block_addr : blocks)
+			{
+				auto iter = map_block.find(block_addr);
+				if (iter == map_block.end() || iter->second.is_stale)
+				{
+					return false;
+				}
+				is_all_ready &= iter->second.is_ready;
+			}
+			if (is_all_ready)
+			{
+				break;
+			}
+			wait(event_block_ready);
+		}
+	}
+
+	for (int i = 0; i < trans.length; i++)
+	{
+		uint64_t addr_beat = axi_beat_address(trans.addr, trans.burst, trans.size, trans.length, i);
+		uint64_t addr_word = axi_word_address(addr_beat);
+		prefetch_block_t& block = map_block[get_block_address(addr_beat)];
+		trans.data[i] = block.data[(addr_word - get_block_address(addr_word)) / BUS_BYTES];
+	}
+	for (uint64_t block_addr : blocks)
+	{
+		prefetch_block_t& block = map_block[block_addr];
+		if (!block.is_used)
+		{
+			count_useful ++;
+		}
+		block.is_used = true;
+	}
+	return true;
+}
+
+void AXI_PREFETCHER::evict_block()
+{
+	while (!q_block_order.empty())
+	{
+		uint64_t block_addr = q_block_order.front();
+		q_block_order.pop_front();
+
+		auto iter = map_block.find(block_addr);
+		if (iter == map_block.end())
+		{
+			continue;
+		}
+		if (!iter->second.is_ready)
+		{
+			// in flight, keep it
+			q_block_order.push_back(block_addr);
+			return;
+		}
+		if (!iter->second.is_used)
+		{
+			count_useless ++;
+		}
+		map_block.erase(iter);
+		return;
+	}
+}
+
+void AXI_PREFETCHER::issue_prefetch(const std::vector<uint64_t>& candidates)
+{
+	for (uint64_t block_addr : candidates)
+	{
+		if (count_prefetch_outstanding >= max_prefetch_outstanding)
+		{
+			return;
+		}
+		if (map_block.count(block_addr))
+		{
+			continue;
+		}
+
+		// do not read around writes still on their way, nor next to
+		// a demand read of the block, whose response could come first
+		bool is_pending = false;
+		for (const prefetch_pending_t& pending : q_pending)
+		{
+			is_pending |= get_block_address(pending.addr) == block_addr;
+		}
+		if (is_pending)
+		{
+			continue;
+		}
+
+		if (map_block.size() >= depth_buffer)
+		{
+			evict_block();
+			if (map_block.size() >= depth_buffer)
+			{
+				return;
+			}
+		}
+
+		prefetch_block_t block;
+		block.is_ready = false;
+		block.is_used = false;
+		block.is_stale = false;
+		map_block[block_addr] = block;
+		q_block_order.push_back(block_addr);
+
+		axi_trans_handle_t trans = axi_trans_alloc();
+		trans->addr = block_addr;
+		trans->length = block_bytes / BUS_BYTES;
+		trans->burst = AXI_BURST_INCR;
+		trans->size = AXI_SIZE_FULL;
+		trans->is_write = false;
+
+		count_prefetch ++;
+		count_prefetch_outstanding ++;
+		count_bytes_prefetch += block_bytes;
+		send_request(trans, true);
+	}
+}
+
+void AXI_PREFETCHER::drop_blocks(const axi_trans_t& trans)
+{
+	for (uint64_t block_addr : get_blocks(trans))
+	{
+		auto iter = map_block.find(block_addr);
+		if (iter == map_block.end())
+		{
+			continue;
+		}
+		if (!iter->second.is_used)
+		{
+			count_useless ++;
+		}
+		if (iter->second.is_ready)
+		{
+			map_block.erase(iter);
+		}
+		else
+		{
+			// the data in flight is old, drop it when it arrives
+			iter->second.is_stale = true;
+		}
+	}
+	event_block_ready.notify(SC_ZERO_TIME);
+}
+
+void AXI_PREFETCHER::fifo_request()
+{
+	// blocking read, the handle goes on downstream or back as the response
+	axi_trans_handle_t handle = request_in.read();
+	axi_trans_t& trans = *handle;
+	log(__FUNCTION__, "GOT_REQUEST", AXI_BUS::transaction_to_string(trans));
+	is_busy = true;
+
+	if (trans.is_write)
+	{
+		drop_blocks(trans);
+		send_request(handle, false);
+		is_busy = false;
+		return;
+	}
+
+	count_demand_read ++;
+	count_bytes_demand += (uint64_t) trans.length << trans.size;
+
+	bool is_hit = serve_from_buffer(trans);
+	if (is_hit)
+	{
+		count_hit ++;
+	}
+
+	std::vector<uint64_t> candidates;
+	if (engine != nullptr)
+	{
+		for (uint64_t block_addr : get_blocks(trans))
+		{
+			engine->observe(block_addr, is_hit, candidates);
+		}
+	}
+
+	if (is_hit)
+	{
+		wait(hit_latency_ns, SC_NS);
+		response_out.write(handle);
+		log(__FUNCTION__, "SENT_RESPONSE_HIT", AXI_BUS::transaction_to_string(trans));
+	}
+	else
+	{
+		// a prefetch of the same burst still on its way, e.g. of a block
+		// written since, would take the response of this read
+		auto is_same_prefetch = [&trans](const prefetch_pending_t& p)
+		{
+			return p.is_prefetch && p.addr == trans.addr && p.length == trans.length;
+		};
+		while (std::any_of(q_pending.begin(), q_pending.end(), is_same_prefetch))
+		{
+			wait(event_block_ready);
+		}
+		send_request(handle, false);
+	}
+
+	issue_prefetch(candidates);
+	is_busy = false;
+}
+
+void AXI_PREFETCHER::fifo_response()
+{
+	// blocking read, a demand response is passed on as it is
+	axi_trans_handle_t handle = response_in.read();
+	const axi_trans_t& trans = *handle;
+	log(__FUNCTION__, "GOT_RESPONSE", AXI_BUS::transaction_to_string(trans));
+
+	// responses may come out of order, the burst length tells a prefetch
+	// from a demand read at the same address
+	auto iter = std::find_if(q_pending.begin(), q_pending.end(),
+		[&trans](const prefetch_pending_t& p)
+		{
+			return p.addr == trans.addr && p.length == trans.length && p.is_write == trans.is_write;
+		});
+	if (iter == q_pending.end())
+	{
+		SC_REPORT_FATAL("AXI_PREFETCHER", "Response, not in progress");
+		return;
+	}
+	bool is_prefetch = iter->is_prefetch;
+	q_pending.erase(iter);
+
+	if (!is_prefetch)
+	{
+		response_out.write(handle);
+		log(__FUNCTION__, "SENT_RESPONSE", AXI_BUS::transaction_to_string(trans));
+		return;
+	}
+
+	count_prefetch_outstanding --;
+	event_block_ready.notify(SC_ZERO_TIME);
+	auto iter_block = map_block.find(trans.addr);
+	if (iter_block == map_block.end())
+	{
+		axi_trans_free(handle);
+		return;
+	}
+	if (iter_block->second.is_stale)
+	{
+		map_block.erase(iter_block);
+	}
+	else
+	{
+		iter_block->second.data.assign(trans.data, trans.data + trans.length);
+		iter_block->second.is_ready = true;
+	}
+	axi_trans_free(handle);
+}
+
+void AXI_PREFETCHER::report_stats()
+{
+	uint64_t count_unused = count_prefetch - count_useful;
+
+	std::cout << "PREFETCHER " << name() << ": engine=" << (engine ? engine->get_name() : "none")
+		<< ", demand_reads=" << count_demand_read
+		<< ", hits=" << count_hit
+		<< ", late_hits=" << count_late_hit
+		<< ", prefetches=" << count_prefetch
+		<< ", useful=" << count_useful
+		<< ", useless=" << count_useless << std::endl;
+	std::cout << "PREFETCHER " << name()
+		<< ": accuracy=" << (count_prefetch ? (double) count_useful / count_prefetch : 0)
+		<< ", coverage=" << (count_demand_read ? (double) count_hit / count_demand_read : 0)
+		<< ", extra_traffic=" << (count_bytes_demand ? (double) count_unused * block_bytes / count_bytes_demand : 0)
+		<< std::endl;
+}
+
+// The prefetch buffer and the history of the engine. A drained
+// prefetcher has no prefetch in flight, so every block is ready.
+
+void AXI_PREFETCHER::save_state(AXI_CHECKPOINT& checkpoint)
+{
+	if (!is_idle())
+	{
+		SC_REPORT_FATAL("AXI_PREFETCHER", "Checkpoint with transactions in flight");
+	}
+
+	// q_block_order keeps the dropped blocks until they reach its front
+	std::vector<uint64_t> list_block;
+	std::unordered_map<uint64_t, bool> map_seen;
+	for (uint64_t block_addr : q_block_order)
+	{
+		if (map_block.count(block_addr) > 0 && !map_seen[block_addr])
+		{
+			map_seen[block_addr] = true;
+			list_block.push_back(block_addr);
+		}
+	}
+
+	checkpoint.put_tag("PREFETCHER:" + std::string(name()));
+	checkpoint.put_uint(block_bytes);
+	checkpoint.put_uint(list_block.size());
+	for (uint64_t block_addr : list_block)
+	{
+		const prefetch_block_t& block = map_block.at(block_addr);
+		checkpoint.put_uint(block_addr);
+		checkpoint.put_bool(block.is_used);
+		for (const bus_data_t& data : block.data)
+		{
+			checkpoint.put_data(data);
+		}
+	}
+	checkpoint.put_string(engine ? engine->get_name() : "none");
+	if (engine != nullptr)
+	{
+		engine->save_state(checkpoint);
+	}
+}
+
+void AXI_PREFETCHER::restore_state(AXI_CHECKPOINT& checkpoint)
+{
+	checkpoint.expect_tag("PREFETCHER:" + std::string(name()));
+	if ((int) checkpoint.get_uint() != block_bytes)
+	{
+		SC_REPORT_FATAL("AXI_PREFETCHER", "Checkpoint of another block size");
+	}
+	map_block.clear();
+	q_block_order.clear();
+	uint64_t count = checkpoint.get_uint();
+	for (uint64_t i = 0; i < count; i++)
+	{
+		uint64_t block_addr = checkpoint.get_uint();
+		prefetch_block_t& block = map_block[block_addr];
+		block.is_ready = true;
+		block.is_used = checkpoint.get_bool();
+		block.is_stale = false;
+		block.data.resize(block_bytes / BUS_BYTES);
+		for (bus_data_t& data : block.data)
+		{
+			data = checkpoint.get_data();
+		}
+		q_block_order.push_back(block_addr);
+	}
+	checkpoint.expect_tag(engine ? engine->get_name() : "none");
+	if (engine != nullptr)
+	{
+		engine->restore_state(checkpoint);
+	}
+}
+
+// Between the workloads of a batch, with all traffic drained.
+
+void AXI_PREFETCHER::soft_reset()
+{
+	map_block.clear();
+	q_block_order.clear();
+	q_pending.clear();
+	count_prefetch_outstanding = 0;
+	is_busy = false;
+	if (engine != nullptr)
+	{
+		engine->reset();
+	}
+
+	count_demand_read = 0;
+	count_hit = 0;
+	count_late_hit = 0;
+	count_prefetch = 0;
+	count_useful = 0;
+	count_useless = 0;
+	count_bytes_demand = 0;
+	count_bytes_prefetch = 0;
+}
+
+bool AXI_PREFETCHER::is_idle()
+{
+	return !is_busy && q_pending.empty() && request_in->num_available() == 0
+		&& response_in->num_available() == 0;
+}
+
+void AXI_PREFETCHER::report_outstanding()
+{
+	std::cout << "PREFETCHER " << name() << ": busy=" << is_busy
+		<< ", pending=" << q_pending.size()
+		<< ", prefetches=" << count_prefetch_outstanding << std::endl;
+}
+
+void AXI_PREFETCHER::log(std::string source, std::string action, std::string detail)
+{
+	std::string sep = ":";
+	std::string log_source = "PREFETCHER" + sep + name() + sep + source;
+	AXI_BUS::log(log_source, action, detail);
+}
@@ -0,0 +1,177 @@
+#ifndef __AXI_PREFETCHER_H__
+#define __AXI_PREFETCHER_H__
+
+#include <systemc>
+#include <deque>
+#include <vector>
+#include <string>
+#include <unordered_map>
+
+#include "axi_param.h"
+#include "axi_bus.h"
+
+class AXI_CHECKPOINT;
+
+// Prefetch engines watch the demand reads and propose blocks to prefetch.
+// Below AXI_BUS the transaction ids are gone, so engines that track
+// streams do it per address region.
+
+class PREFETCH_ENGINE
+{
+public:
+	virtual ~PREFETCH_ENGINE() {}
+	virtual std::string get_name() const = 0;
+
+	// A demand read of block_addr. Adds the blocks to prefetch to candidates.
+	virtual void observe(uint64_t block_addr, bool is_hit, std::vector<uint64_t>& candidates) = 0;
+
+	// forget the history, between the workloads of a batch
+	virtual void reset() {}
+
+	// the history, for checkpoints
+	virtual void save_state(AXI_CHECKPOINT& checkpoint) {}
+	virtual void restore_state(AXI_CHECKPOINT& checkpoint) {}
+
+	int block_bytes = 64;		// set by AXI_PREFETCHER
+};
+
+// the next degree blocks after every demand read
+class PREFETCH_NEXT_LINE : public PREFETCH_ENGINE
+{
+public:
+	int degree = 1;
+
+	std::string get_name() const override { return "next-line"; }
+	void observe(uint64_t block_addr, bool is_hit, std::vector<uint64_t>& candidates) override;
+};
+
+// constant stride detection, one entry per region
+class PREFETCH_STRIDE : public PREFETCH_ENGINE
+{
+public:
+	typedef struct
+	{
+		uint64_t	addr_last;
+		int64_t		stride;
+		int			confidence;
+	} stride_entry_t;
+
+	int degree = 2;
+	uint64_t region_bytes = 4096;
+	int confidence_min = 2;		// same stride seen this many times
+	std::unordered_map<uint64_t, stride_entry_t> map_region;
+
+	std::string get_name() const override { return "stride"; }
+	void observe(uint64_t block_addr, bool is_hit, std::vector<uint64_t>& candidates) override;
+	void reset() override { map_region.clear(); }
+	void save_state(AXI_CHECKPOINT& checkpoint) override;
+	void restore_state(AXI_CHECKPOINT& checkpoint) override;
+};
+
+// stream buffers, a miss allocates a stream running ahead of the reads
+class PREFETCH_STREAM : public PREFETCH_ENGINE
+{
+public:
+	typedef struct
+	{
+		uint64_t	addr_next;		// next block the stream expects
+		int			count_ahead;	// blocks prefetched beyond addr_next
+		uint64_t	stamp_used;
+	} stream_t;
+
+	int count_stream = 4;
+	int depth = 4;
+	std::vector<stream_t> streams;
+	uint64_t stamp_access = 0;
+
+	std::string get_name() const override { return "stream"; }
+	void observe(uint64_t block_addr, bool is_hit, std::vector<uint64_t>& candidates) override;
+	void reset() override { streams.clear(); stamp_access = 0; }
+	void save_state(AXI_CHECKPOINT& checkpoint) override;
+	void restore_state(AXI_CHECKPOINT& checkpoint) override;
+};
+
+// a block in the prefetch buffer
+typedef struct
+{
+	bool					is_ready;	// data arrived
+	bool					is_used;	// a demand read hit it
+	bool					is_stale;	// written while in flight
+	std::vector<bus_data_t>	data;
+} prefetch_block_t;
+
+// a transaction sent downstream
+typedef struct
+{
+	uint64_t	addr;
+	uint16_t	length;
+	bool		is_write;
+	bool		is_prefetch;
+} prefetch_pending_t;
+
+// Prefetcher between AXI_BUS and AXI_SUBORDINATE.
+// Demand reads fully held by the prefetch buffer are answered after
+// hit_latency_ns, the rest goes downstream. Writes go downstream and
+// drop the blocks they touch.
+
+SC_MODULE(AXI_PREFETCHER)
+{
+	sc_fifo_in<axi_trans_handle_t> request_in;
+	sc_fifo_out<axi_trans_handle_t> response_out;
+	sc_fifo_out<axi_trans_handle_t> request_out;
+	sc_fifo_in<axi_trans_handle_t> response_in;
+
+	PREFETCH_ENGINE* engine = nullptr;
+
+	int block_bytes = 64;			// multiple of the bus width
+	size_t depth_buffer = 16;		// blocks
+	int max_prefetch_outstanding = 4;
+	int hit_latency_ns = 1;
+
+	std::unordered_map<uint64_t, prefetch_block_t> map_block;
+	std::deque<uint64_t> q_block_order;		// for FIFO replacement
+	std::deque<prefetch_pending_t> q_pending;
+	int count_prefetch_outstanding = 0;
+	sc_event event_block_ready;
+	bool is_busy = false;		// a request is being served
+
+	// statistics
+	uint64_t count_demand_read = 0;
+	uint64_t count_hit = 0;
+	uint64_t count_late_hit = 0;		// block was still in flight
+	uint64_t count_prefetch = 0;
+	uint64_t count_useful = 0;
+	uint64_t count_useless = 0;		// evicted or dropped without use
+	uint64_t count_bytes_demand = 0;
+	uint64_t count_bytes_prefetch = 0;
+
+	SC_CTOR(AXI_PREFETCHER)
+	{
+		SC_THREAD(thread_request);
+		SC_THREAD(thread_response);
+	}
+
+	void end_of_elaboration() override;
+	void thread_request();
+	void thread_response();
+	void fifo_request();
+	void fifo_response();
+
+	uint64_t get_block_address(uint64_t addr) const;
+	std::vector<uint64_t> get_blocks(const axi_trans_t& trans) const;
+	bool serve_from_buffer(axi_trans_t& trans);
+	void issue_prefetch(const std::vector<uint64_t>& candidates);
+	void evict_block();
+	void drop_blocks(const axi_trans_t& trans);
+	void send_request(axi_trans_handle_t trans, bool is_prefetch);
+
+	void report_stats();
+	void soft_reset();
+	void save_state(AXI_CHECKPOINT& checkpoint);
+	void restore_state(AXI_CHECKPOINT& checkpoint);
+	bool is_idle();
+	void report_outstanding();
+	void log(std::string source, std::string action, std::string detail);
+};
+
+#endif
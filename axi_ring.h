@@ -0,0 +1,93 @@
+#ifndef __AXI_RING_H__
+#define __AXI_RING_H__
+
+#include <systemc>
+#include <vector>
+#include <string>
+
+// Fixed capacity FIFO for the channel queues of AXI_BUS.
+// The slots are allocated once by set_capacity(), so pushing and popping
+// a beat never allocates. Pushing into a full ring is an error;
+// the caller checks full() first and stalls.
+
+template <typename T>
+class AXI_RING
+{
+public:
+	void set_capacity(size_t capacity)
+	{
+		if (count > 0 || capacity == 0)
+		{
+			SC_REPORT_FATAL("AXI_RING", ("Invalid capacity " + std::to_string(capacity)).c_str());
+		}
+		slots.assign(capacity, T());
+		head = 0;
+	}
+
+	size_t capacity() const	{ return slots.size(); }
+	size_t size() const		{ return count; }
+	size_t free() const		{ return slots.size() - count; }
+	bool empty() const		{ return count == 0; }
+	bool full() const		{ return count == slots.size(); }
+
+	T& front()				{ return slots[head]; }
+	const T& front() const	{ return slots[head]; }
+
+	void push(const T& value)
+	{
+		if (full())
+		{
+			SC_REPORT_FATAL("AXI_RING", "Push into a full ring");
+			return;
+		}
+		size_t tail = head + count;
+		if (tail >= slots.size())
+		{
+			tail -= slots.size();
+		}
+		slots[tail] = value;
+		count ++;
+		count_push ++;
+		if (count > max_occupancy)
+		{
+			max_occupancy = count;
+		}
+	}
+
+	void pop()
+	{
+		if (empty())
+		{
+			SC_REPORT_FATAL("AXI_RING", "Pop from an empty ring");
+			return;
+		}
+		head ++;
+		if (head == slots.size())
+		{
+			head = 0;
+		}
+		count --;
+	}
+
+	// drops the entries and the statistics, keeps the slots
+	void clear()
+	{
+		head = 0;
+		count = 0;
+		count_push = 0;
+		count_full = 0;
+		max_occupancy = 0;
+	}
+
+	// statistics
+	uint64_t count_push = 0;
+	uint64_t count_full = 0;		// stalls of the producer, counted by the caller
+	size_t max_occupancy = 0;
+
+private:
+	std::vector<T> slots;
+	size_t head = 0;
+	size_t count = 0;
+};
+
+#endif
@@ -0,0 +1,155 @@
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <systemc>
+
+using namespace sc_core;
+using namespace sc_dt;
+
+#include "axi_sampler.h"
+
+bool AXI_SAMPLER::is_valid() const
+{
+	if (!is_enabled())
+	{
+		return true;
+	}
+	return window > 0 && warmup + window <= period && get_z() > 0;
+}
+
+int AXI_SAMPLER::get_phase(uint64_t index) const
+{
+	if (!is_enabled())
+	{
+		return SAMPLE_MEASURE;
+	}
+
+	uint64_t offset = index % period;
+	if (offset < warmup)
+	{
+		return SAMPLE_WARMUP;
+	}
+	if (offset < warmup + window)
+	{
+		return SAMPLE_MEASURE;
+	}
+	return SAMPLE_FUNCTIONAL;
+}
+
+// A retired access of a measured window.
+
+void AXI_SAMPLER::record(uint64_t index, uint64_t latency_ns, uint64_t bytes,
+	uint64_t stamp_issue_ns, uint64_t stamp_retire_ns)
+{
+	if (!is_enabled() || get_phase(index) != SAMPLE_MEASURE)
+	{
+		return;
+	}
+
+	uint64_t unit = index / period;
+	if (windows.size() <= unit)
+	{
+		windows.resize(unit + 1, sample_window_t{0, 0, 0, UINT64_MAX, 0});
+	}
+
+	sample_window_t& w = windows[unit];
+	w.count ++;
+	w.sum_latency_ns += latency_ns;
+	w.bytes += bytes;
+	w.stamp_first_issue_ns = std::min(w.stamp_first_issue_ns, stamp_issue_ns);
+	w.stamp_last_retire_ns = std::max(w.stamp_last_retire_ns, stamp_retire_ns);
+}
+
+double AXI_SAMPLER::get_z() const
+{
+	// two sided, standard normal
+	if (confidence == 0.90)	return 1.645;
+	if (confidence == 0.95)	return 1.960;
+	if (confidence == 0.99)	return 2.576;
+	return 0;
+}
+
+sample_estimate_t AXI_SAMPLER::estimate(const std::vector<double>& samples) const
+{
+	sample_estimate_t result = {samples.size(), 0, 0};
+	if (samples.empty())
+	{
+		return result;
+	}
+
+	double sum = 0;
+	for (double x : samples)
+	{
+		sum += x;
+	}
+	result.mean = sum / samples.size();
+	if (samples.size() < 2)
+	{
+		return result;
+	}
+
+	double sum_square = 0;
+	for (double x : samples)
+	{
+		sum_square += (x - result.mean) * (x - result.mean);
+	}
+	double stddev = std::sqrt(sum_square / (samples.size() - 1));
+	result.half_width = get_z() * stddev / std::sqrt((double) samples.size());
+	return result;
+}
+
+// mean latency of each window, in nano seconds
+
+sample_estimate_t AXI_SAMPLER::estimate_latency() const
+{
+	std::vector<double> samples;
+	for (const sample_window_t& w : windows)
+	{
+		if (w.count > 0)
+		{
+			samples.push_back((double) w.sum_latency_ns / w.count);
+		}
+	}
+	return estimate(samples);
+}
+
+// bandwidth of each window, in bytes per nano second
+
+sample_estimate_t AXI_SAMPLER::estimate_bandwidth() const
+{
+	std::vector<double> samples;
+	for (const sample_window_t& w : windows)
+	{
+		if (w.count > 0 && w.stamp_last_retire_ns > w.stamp_first_issue_ns)
+		{
+			samples.push_back((double) w.bytes / (w.stamp_last_retire_ns - w.stamp_first_issue_ns));
+		}
+	}
+	return estimate(samples);
+}
+
+void AXI_SAMPLER::report(const std::string& name) const
+{
+	if (!is_enabled())
+	{
+		return;
+	}
+
+	sample_estimate_t latency = estimate_latency();
+	sample_estimate_t bandwidth = estimate_bandwidth();
+
+	std::cout << "SAMPLER " << name << ": windows=" << latency.count
+		<< ", period=" << period
+		<< ", warmup=" << warmup
+		<< ", window=" << window
+		<< ", confidence=" << confidence << std::endl;
+	std::cout << "SAMPLER " << name << ": latency=" << latency.mean
+		<< " +- " << latency.half_width << " ns"
+		<< ", bandwidth=" << bandwidth.mean
+		<< " +- " << bandwidth.half_width << " bytes/ns" << std::endl;
+	if (latency.count < 30)
+	{
+		std::cout << "SAMPLER " << name << ": fewer than 30 windows,"
+			<< " the confidence intervals are rough" << std::endl;
+	}
+}
@@ -0,0 +1,68 @@
+#ifndef __AXI_SAMPLER_H__
+#define __AXI_SAMPLER_H__
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// Systematic sampling of an access trace.
+//
+// The trace is cut into units of period accesses, by access index.
+// The first warmup accesses of a unit run in detail to warm up queues,
+// caches and prefetchers, the next window accesses run in detail and are
+// measured, and the rest of the unit is fast-forwarded functionally,
+// straight into the memory images without bus timing.
+//
+// Each window gives one sample of the mean latency and of the bandwidth.
+// The estimates are the means of the samples, with confidence intervals
+// from the normal approximation, so they want 30 windows or more.
+
+#define SAMPLE_MEASURE		0	// detailed and measured
+#define SAMPLE_WARMUP		1	// detailed, not measured
+#define SAMPLE_FUNCTIONAL	2	// fast-forwarded
+
+typedef struct
+{
+	uint64_t	count;
+	uint64_t	sum_latency_ns;
+	uint64_t	bytes;
+	uint64_t	stamp_first_issue_ns;
+	uint64_t	stamp_last_retire_ns;
+} sample_window_t;
+
+typedef struct
+{
+	size_t	count;
+	double	mean;
+	double	half_width;		// of the confidence interval
+} sample_estimate_t;
+
+class AXI_SAMPLER
+{
+public:
+	// 0 is no sampling, every access is measured
+	uint64_t period = 0;
+	uint64_t warmup = 0;
+	uint64_t window = 0;
+	double confidence = 0.95;	// 0.90, 0.95 or 0.99
+
+	bool is_enabled() const { return period > 0; }
+	bool is_valid() const;
+	int get_phase(uint64_t index) const;
+
+	void record(uint64_t index, uint64_t latency_ns, uint64_t bytes,
+		uint64_t stamp_issue_ns, uint64_t stamp_retire_ns);
+	void clear() { windows.clear(); }
+
+	sample_estimate_t estimate_latency() const;
+	sample_estimate_t estimate_bandwidth() const;
+	void report(const std::string& name) const;
+
+	std::vector<sample_window_t> windows;	// by unit
+
+private:
+	double get_z() const;
+	sample_estimate_t estimate(const std::vector<double>& samples) const;
+};
+
+#endif
@@ -12,10 +12,9 @@ using namespace sc_core;
 using namespace sc_dt;
 
 #include "axi_subordinate.h"
+#include "axi_checkpoint.h"
 
 #define NANOSECONDS_PER_SECOND (1000 * 1000 * 1000)
-#define AXI_SUBORDINATE_READ_LATENCY_NS 2
-#define AXI_SUBORDINATE_WRITE_LATENCY_NS 3
 
 void AXI_SUBORDINATE::thread_reader()
 {
@@ -34,32 +33,84 @@ void AXI_SUBORDINATE::thread_writer()
 	}
 }
 
-void AXI_SUBORDINATE::fifo_reader()
+bool AXI_SUBORDINATE::is_request_queue_full()
 {
-	std::string log_action;
-	std::string log_detail;
+	if (depth_request_max <= 0)
+	{
+		return false;
+	}
+	return (q_request.size() >= (size_t) depth_request_max);
+}
 
-	axi_trans_t trans;
-	int latency_ns = 0;
-	uint64_t stamp_schedule_ns;
+void AXI_SUBORDINATE::fifo_reader()
+{
+	axi_trans_handle_t trans;
 	uint64_t stamp_now_ns;
 
+	if (is_request_queue_full())
+	{
+		// Do not read the request fifo.
+		// It fills up, and the bus deasserts READY.
+		log(__FUNCTION__, "FULL", "queued=" + std::to_string(q_request.size())
+			+ ", in_service=" + std::to_string(count_in_service));
+		wait(event_slot_free);
+		return;
+	}
+
 	// Receive incoming requests. This is a blocking read.
 	trans = request.read();
-	log(__FUNCTION__, "GOT_REQUEST", AXI_BUS::transaction_to_string(trans));
+	log(__FUNCTION__, "GOT_REQUEST", AXI_BUS::transaction_to_string(*trans));
 
-	latency_ns = get_latency_ns(trans);
 	// +0.5 is needed for rounding
 	stamp_now_ns = sc_time_stamp().to_seconds() * NANOSECONDS_PER_SECOND + 0.5;
-	stamp_schedule_ns = stamp_now_ns + latency_ns;
-	mutex_q.lock();
+	q_request.push(std::make_tuple(stamp_now_ns, trans));
+	max_request_occupancy = std::max(max_request_occupancy, q_request.size());
+
+	dispatch_requests();
+}
+
+// Move waiting requests into free service slots.
+
+void AXI_SUBORDINATE::dispatch_requests()
+{
+	// +0.5 is needed for rounding
+	uint64_t stamp_now_ns = sc_time_stamp().to_seconds() * NANOSECONDS_PER_SECOND + 0.5;
+
+	while (!q_request.empty())
+	{
+		if (count_slot_max > 0 && count_in_service >= count_slot_max)
+		{
+			log(__FUNCTION__, "NO_SLOT", "queued=" + std::to_string(q_request.size())
+				+ ", in_service=" + std::to_string(count_in_service));
+			return;
+		}
+
+		uint64_t stamp_arrival_ns = std::get<0>(q_request.front());
+		axi_trans_handle_t trans = std::get<1>(q_request.front());
+		q_request.pop();
+
+		uint64_t queueing_ns = stamp_now_ns - stamp_arrival_ns;
+		sum_queueing_ns += queueing_ns;
+		max_queueing_ns = std::max(max_queueing_ns, queueing_ns);
+
+		count_in_service ++;
+		schedule_response(trans, stamp_now_ns);
+		event_slot_free.notify(SC_ZERO_TIME);
+	}
+}
+
+void AXI_SUBORDINATE::schedule_response(axi_trans_handle_t trans, uint64_t stamp_now_ns)
+{
+	std::string log_detail;
+	int latency_ns = get_latency_ns(*trans);
+	uint64_t stamp_schedule_ns = stamp_now_ns + latency_ns;
+
 	event_something_to_send.notify (latency_ns, SC_NS);
 	q_send.push(when_trans_t(stamp_schedule_ns, trans));
-	mutex_q.unlock();
 
 	log_detail = "scheduled=" + std::to_string(stamp_schedule_ns);
 	log_detail += ", latency=" + std::to_string(latency_ns);
-	log_detail += ", " + AXI_BUS::transaction_to_string(trans);
+	log_detail += ", " + AXI_BUS::transaction_to_string(*trans);
 	log(__FUNCTION__, "SCHEDULE_RESPONSE", log_detail);
 }
 
@@ -70,17 +121,15 @@ void AXI_SUBORDINATE::fifo_writer()
 
 	uint64_t stamp_schedule_ns;
 	uint64_t stamp_now_ns;
-	axi_trans_t trans;
+	axi_trans_handle_t trans;
 
-	mutex_q.lock();
 	if (q_send.empty())
 	{
 		log(__FUNCTION__, "EMPTY_QUEUE", "");
-		mutex_q.unlock();
 		return;
 	}
 
-	when_trans_t when_trans = q_send.top();
+	const when_trans_t& when_trans = q_send.top();
 	stamp_schedule_ns = when_trans.stamp;
 	trans = when_trans.trans;
 	// +0.5 is needed for rounding
@@ -89,28 +138,49 @@ void AXI_SUBORDINATE::fifo_writer()
 	if (stamp_now_ns < stamp_schedule_ns)
 	{
 		log(__FUNCTION__, "WAITING", "stamp_now=" + std::to_string(stamp_now_ns) + ", stamp_schedule=" + std::to_string(stamp_schedule_ns));
-		mutex_q.unlock();
 		return;
 	}
 
 	q_send.pop();
-	mutex_q.unlock();
+	access_memory(*trans);
 
-	uint64_t amount_addr_inc = DATA_WIDTH / 8;
+	response.write(trans);
+	log(__FUNCTION__, "SENT_RESPONSE", AXI_BUS::transaction_to_string(*trans));
+
+	// the slot is free now
+	count_in_service --;
+	count_served ++;
+	dispatch_requests();
+	event_slot_free.notify(SC_ZERO_TIME);
+}
+
+// Write the data of a write, or fill in the data of a read.
+// Also the functional path of sampled simulation, without timing.
+
+void AXI_SUBORDINATE::access_memory(axi_trans_t& trans)
+{
 	for (int i = 0; i < trans.length; i ++)
 	{
-		uint64_t addr = trans.addr + amount_addr_inc * i;
+		uint64_t addr_beat = axi_beat_address(trans.addr, trans.burst, trans.size, trans.length, i);
+		uint64_t addr = axi_word_address(addr_beat);
 
 		if (trans.is_write)
 		{
-			map_memory[addr] = trans.data[i];
+			// only the byte lanes enabled by the strobe are written
+			if (trans.strb[i] != 0)
+			{
+				write_word(addr, trans.data[i], trans.strb[i]);
+			}
 		}
 		else
 		{
-			auto iter = map_memory.find(addr);
-			if (iter != map_memory.end())
+			if (read_word(addr, trans.data[i]))
+			{
+				continue;
+			}
+			if (is_unmapped_zero)
 			{
-				trans.data[i] = map_memory[addr];
+				trans.data[i] = 0;
 			}
 			else
 			{
@@ -118,41 +188,87 @@ void AXI_SUBORDINATE::fifo_writer()
 			}
 		}
 	}
-
-	response.write(trans);
-	log(__FUNCTION__, "SENT_RESPONSE", AXI_BUS::transaction_to_string(trans));
 }
 
-int AXI_SUBORDINATE::get_latency_ns(axi_trans_t trans)
-{
-	int latency_by_address = 0;
-	int latency_by_access_type = 0;
-	int latency_total_ns = 0;
+// The written words first, then the base image. False when neither
+// has the address.
 
-	if(trans.is_write)
+bool AXI_SUBORDINATE::read_word(uint64_t addr, bus_data_t& data) const
+{
+	auto iter = map_memory.find(addr);
+	if (iter != map_memory.end())
+	{
+		data = iter->second;
+		return true;
+	}
+	if (map_memory_base == nullptr)
 	{
-		latency_by_access_type = AXI_SUBORDINATE_WRITE_LATENCY_NS;
+		return false;
 	}
-	else
+	iter = map_memory_base->find(addr);
+	if (iter != map_memory_base->end())
 	{
-		latency_by_access_type = AXI_SUBORDINATE_READ_LATENCY_NS;
+		data = iter->second;
+		return true;
 	}
+	return false;
+}
+
+// only the byte lanes enabled by the strobe, the base is left as it is
 
-	if (trans.addr < 0x8000100010001000)
+void AXI_SUBORDINATE::write_word(uint64_t addr, const bus_data_t& data, bus_strb_t strb)
+{
+	bus_data_t old = 0;
+	read_word(addr, old);
+	map_memory[addr] = bus_data_merge(old, data, strb);
+}
+
+// Start from an image read before, instead of reading the file again.
+// It is not copied and has to outlive the workload.
+
+void AXI_SUBORDINATE::set_memory_base(const std::unordered_map<uint64_t, bus_data_t>* base)
+{
+	map_memory.clear();
+	map_memory_base = base;
+}
+
+// the base image with the written words over it
+
+std::unordered_map<uint64_t, bus_data_t> AXI_SUBORDINATE::get_memory() const
+{
+	if (map_memory_base == nullptr)
 	{
-		latency_by_address = 10;
+		return map_memory;
 	}
-	else
+	std::unordered_map<uint64_t, bus_data_t> memory(*map_memory_base);
+	for (const auto& row : map_memory)
 	{
-		latency_by_address = 0;
+		memory[row.first] = row.second;
 	}
+	return memory;
+}
 
-	latency_total_ns = latency_by_access_type + latency_by_address;
-	return latency_total_ns;
+int AXI_SUBORDINATE::get_latency_ns(axi_trans_t trans)
+{
+	return latency_model.get_latency_ns(trans.addr, trans.length, trans.is_write);
 }
+
+void AXI_SUBORDINATE::read_latency_csv()
+{
+	latency_model.read_csv(filename_latency);
+	log(__FUNCTION__, "LATENCY_REGIONS", std::to_string(latency_model.size()));
+}
+
+void AXI_SUBORDINATE::set_seed(uint32_t seed)
+{
+	this->seed = seed;
+	latency_model.set_seed(seed);
+}
+
 void AXI_SUBORDINATE::read_memory_csv()
 {
 	map_memory.clear();
+	map_memory_base = nullptr;
 
 	std::ifstream f(filename_memory);
 	if (!f.is_open())
@@ -185,7 +301,7 @@ void AXI_SUBORDINATE::read_memory_csv()
 	}
 }
 
-void AXI_SUBORDINATE::write_memory_csv(const char *filename)
+void AXI_SUBORDINATE::write_memory_csv(const std::string& filename)
 {
 	std::ofstream f(filename);
 	if (!f.is_open())
@@ -194,7 +310,15 @@ void AXI_SUBORDINATE::write_memory_csv(const char *filename)
 		return;
 	}
 
-	std::map<uint64_t, bus_data_t> map_ordered(map_memory.begin(), map_memory.end());
+	std::map<uint64_t, bus_data_t> map_ordered;
+	if (map_memory_base != nullptr)
+	{
+		map_ordered.insert(map_memory_base->begin(), map_memory_base->end());
+	}
+	for (const auto& row : map_memory)
+	{
+		map_ordered[row.first] = row.second;
+	}
 	for (auto row : map_ordered)
 	{
 		uint64_t address = std::get<0>(row);
@@ -204,6 +328,73 @@ void AXI_SUBORDINATE::write_memory_csv(const char *filename)
 	}
 }
 
+void AXI_SUBORDINATE::report_stats()
+{
+	std::cout << "SUBORDINATE " << name() << ": served=" << count_served
+		<< ", max_queued=" << max_request_occupancy
+		<< ", max_queueing=" << max_queueing_ns << " ns"
+		<< ", avg_queueing=" << (count_served ? (double) sum_queueing_ns / count_served : 0)
+		<< " ns" << std::endl;
+}
+
+// Back to the state after elaboration, between the workloads of a batch.
+// Only called while the simulation is paused with all traffic drained.
+// The memory image is read again by read_memory_csv, or set again by
+// set_memory_base.
+
+void AXI_SUBORDINATE::soft_reset()
+{
+	q_request = decltype(q_request)();
+	q_send = decltype(q_send)();
+	map_memory.clear();
+	map_memory_base = nullptr;
+	count_in_service = 0;
+
+	// the latencies of a workload do not depend on the ones before it
+	latency_model.set_seed(seed);
+
+	count_served = 0;
+	sum_queueing_ns = 0;
+	max_queueing_ns = 0;
+	max_request_occupancy = 0;
+}
+
+// The memory image of a drained subordinate, and the jitter generator.
+
+void AXI_SUBORDINATE::save_state(AXI_CHECKPOINT& checkpoint)
+{
+	if (!is_idle())
+	{
+		SC_REPORT_FATAL("AXI_SUBORDINATE", "Checkpoint with transactions in flight");
+	}
+
+	checkpoint.put_tag("SUBORDINATE:" + std::string(name()));
+	checkpoint.put_memory(get_memory());
+	checkpoint.put_string(latency_model.get_random_state());
+}
+
+void AXI_SUBORDINATE::restore_state(AXI_CHECKPOINT& checkpoint)
+{
+	checkpoint.expect_tag("SUBORDINATE:" + std::string(name()));
+	checkpoint.get_memory(map_memory);
+	map_memory_base = nullptr;
+	latency_model.set_random_state(checkpoint.get_string());
+}
+
+bool AXI_SUBORDINATE::is_idle()
+{
+	return q_request.empty() && q_send.empty() && count_in_service == 0
+		&& request->num_available() == 0;
+}
+
+void AXI_SUBORDINATE::report_outstanding()
+{
+	std::cout << "SUBORDINATE " << name() << ": queued=" << q_request.size()
+		<< ", in_service=" << count_in_service
+		<< ", responses=" << q_send.size()
+		<< ", request_fifo=" << request->num_available() << std::endl;
+}
+
 void AXI_SUBORDINATE::log(std::string source, std::string action, std::string detail)
 {
 	std::string sep = ":";
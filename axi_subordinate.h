@@ -1,3 +1,6 @@
+#ifndef __AXI_SUBORDINATE_H__
+#define __AXI_SUBORDINATE_H__
+
 #include <fstream>
 #include <queue>
 #include <sstream>
@@ -7,13 +10,15 @@
 
 #include "axi_param.h"
 #include "axi_bus.h"
+#include "axi_latency.h"
 
+// the request handle, written back as its own response
 struct when_trans_t
 {
 	uint64_t stamp;
-	axi_trans_t trans;
+	axi_trans_handle_t trans;
 
-	when_trans_t(uint64_t s, axi_trans_t t)
+	when_trans_t(uint64_t s, axi_trans_handle_t t)
 	{
 		stamp = s;
 		trans = t;
@@ -26,19 +31,48 @@ struct when_trans_t
 	}
 };
 
+class AXI_CHECKPOINT;
+
 SC_MODULE(AXI_SUBORDINATE)
 {
-	sc_fifo_in<axi_trans_t> request;
-	sc_fifo_out<axi_trans_t> response;
+	sc_fifo_in<axi_trans_handle_t> request;
+	sc_fifo_out<axi_trans_handle_t> response;
 
-	std::mutex mutex_q;
 	sc_event_queue event_something_to_send;
 	std::priority_queue<when_trans_t> q_send;
 
-	// pair<address, data>
+	// Requests waiting for a service slot: (arrival stamp, transaction)
+	// When the queue is full, fifo_reader stops draining the request fifo,
+	// so that the bus sees backpressure.
+	std::queue<std::tuple<uint64_t, axi_trans_handle_t>> q_request;
+	sc_event event_slot_free;
+
+	// 0 means unlimited
+	int count_slot_max = 0;		// transactions served at the same time
+	int depth_request_max = 0;	// transactions waiting for a slot
+	int count_in_service = 0;
+
+	// statistics
+	uint64_t count_served = 0;
+	uint64_t sum_queueing_ns = 0;
+	uint64_t max_queueing_ns = 0;
+	size_t max_request_occupancy = 0;
+
+	// pair<address, data>. With a base image, only the words written since
+	// it was set, the others are read from the base.
 	std::unordered_map<uint64_t, bus_data_t> map_memory;
+	// read-only image shared by the workloads of a batch, or nullptr
+	const std::unordered_map<uint64_t, bus_data_t>* map_memory_base = nullptr;
+
+	// Reads of addresses not in the memory image return zero instead of
+	// failing. Needed when a cache reads whole lines.
+	bool is_unmapped_zero = false;
 
-	const char *filename_memory = "s_memory.csv";
+	std::string filename_memory = "s_memory.csv";
+	std::string filename_latency = "s_latency.csv";
+
+	AXI_LATENCY_MODEL latency_model;
+	uint32_t seed = 0;			// of the latency jitter, again at each soft reset
 
 	SC_CTOR(AXI_SUBORDINATE)
 	{
@@ -50,12 +84,30 @@ SC_MODULE(AXI_SUBORDINATE)
 	void thread_reader();
 	void thread_writer();
 
-	void fifo_reader();
-	void fifo_writer();
+	virtual void fifo_reader();
+	virtual void fifo_writer();
 
 	int get_latency_ns(axi_trans_t trans);
+	bool is_request_queue_full();
+	void dispatch_requests();
+	void schedule_response(axi_trans_handle_t trans, uint64_t stamp_now_ns);
+	void access_memory(axi_trans_t& trans);
+	bool read_word(uint64_t addr, bus_data_t& data) const;
+	void write_word(uint64_t addr, const bus_data_t& data, bus_strb_t strb);
+	void set_memory_base(const std::unordered_map<uint64_t, bus_data_t>* base);
+	std::unordered_map<uint64_t, bus_data_t> get_memory() const;
 
+	void read_latency_csv();
+	void set_seed(uint32_t seed);
 	void read_memory_csv();
-	void write_memory_csv(const char* filename="s_memory_after.csv");
+	void write_memory_csv(const std::string& filename="s_memory_after.csv");
+	virtual void report_stats();
+	virtual void soft_reset();
+	virtual void save_state(AXI_CHECKPOINT& checkpoint);
+	virtual void restore_state(AXI_CHECKPOINT& checkpoint);
+	virtual bool is_idle();
+	virtual void report_outstanding();
 	void log(std::string source, std::string action, std::string detail);
 };
+
+#endif
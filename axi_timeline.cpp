@@ -0,0 +1,128 @@
+#include <iostream>
+#include <systemc>
+#include <string>
+
+using namespace sc_core;
+using namespace sc_dt;
+
+#include "axi_timeline.h"
+
+bool AXI_TIMELINE::open(const std::string& filename)
+{
+	this->filename = filename;
+	f_out.open(filename);
+	if (!f_out.is_open())
+	{
+		std::cerr << "Error: could not open " << filename << std::endl;
+		return false;
+	}
+
+	// the stamps are in micro seconds, shown in nano seconds
+	f_out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+	return true;
+}
+
+void AXI_TIMELINE::close()
+{
+	if (!f_out.is_open())
+	{
+		return;
+	}
+
+	f_out << "\n]}\n";
+	f_out.close();
+	if (f_out.fail())
+	{
+		SC_REPORT_FATAL("AXI_TIMELINE", ("Write failed: " + filename).c_str());
+	}
+}
+
+int AXI_TIMELINE::add_process(const std::string& name)
+{
+	int pid = ++ count_process;
+	write_head("M", pid, 0);
+	f_out << ",\"name\":\"process_name\",\"args\":{\"name\":\"" << escape(name) << "\"}}";
+	return pid;
+}
+
+// once per track, the first name wins
+
+void AXI_TIMELINE::name_track(int pid, int tid, const std::string& name)
+{
+	if (!set_named.insert(std::make_pair(pid, tid)).second)
+	{
+		return;
+	}
+	write_head("M", pid, tid);
+	f_out << ",\"name\":\"thread_name\",\"args\":{\"name\":\"" << escape(name) << "\"}}";
+	write_head("M", pid, tid);
+	f_out << ",\"name\":\"thread_sort_index\",\"args\":{\"sort_index\":" << tid << "}}";
+}
+
+void AXI_TIMELINE::begin(int pid, int tid, const std::string& name, const std::string& detail)
+{
+	write_head("B", pid, tid);
+	f_out << ",\"name\":\"" << escape(name) << "\"";
+	if (!detail.empty())
+	{
+		f_out << ",\"args\":{\"detail\":\"" << escape(detail) << "\"}";
+	}
+	f_out << "}";
+}
+
+void AXI_TIMELINE::end(int pid, int tid)
+{
+	write_head("E", pid, tid);
+	f_out << "}";
+}
+
+void AXI_TIMELINE::complete(int pid, int tid, const std::string& name, uint64_t duration_ns,
+	const std::string& detail)
+{
+	write_head("X", pid, tid);
+	f_out << ",\"dur\":" << stamp_to_us(duration_ns) << ",\"name\":\"" << escape(name) << "\"";
+	if (!detail.empty())
+	{
+		f_out << ",\"args\":{\"detail\":\"" << escape(detail) << "\"}";
+	}
+	f_out << "}";
+}
+
+// the common fields of an event, without the closing brace
+
+void AXI_TIMELINE::write_head(const char* phase, int pid, int tid)
+{
+	uint64_t stamp_now = sc_time_stamp().value() / 1000; // ps to ns convert.
+
+	if (count_event > 0)
+	{
+		f_out << ",\n";
+	}
+	count_event ++;
+	f_out << "{\"ph\":\"" << phase << "\",\"pid\":" << pid << ",\"tid\":" << tid
+		<< ",\"ts\":" << stamp_to_us(stamp_now);
+}
+
+std::string AXI_TIMELINE::stamp_to_us(uint64_t stamp_ns)
+{
+	std::string fraction = std::to_string(stamp_ns % 1000);
+	return std::to_string(stamp_ns / 1000) + "." + std::string(3 - fraction.size(), '0') + fraction;
+}
+
+std::string AXI_TIMELINE::escape(const std::string& s)
+{
+	std::string result;
+	for (char c : s)
+	{
+		if (c == '"' || c == '\\')
+		{
+			result += '\\';
+		}
+		if ((unsigned char) c < 0x20)
+		{
+			continue;
+		}
+		result += c;
+	}
+	return result;
+}
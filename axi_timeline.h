@@ -0,0 +1,54 @@
+#ifndef __AXI_TIMELINE_H__
+#define __AXI_TIMELINE_H__
+
+#include <string>
+#include <fstream>
+#include <set>
+#include <utility>
+#include <cstdint>
+
+// Timeline of the bus traffic in the Chrome trace event format, for
+// chrome://tracing or ui.perfetto.dev.
+//
+// Every bus is a process with one track per channel, where each transfer
+// (VALID and READY) is a one clock slice, and one track per AxID, where
+// a transaction is a slice from its ID allocation to the response to the
+// manager, with the service by the subordinate nested in it.
+//
+// Events are written as they happen and the file keeps no state but the
+// names of the tracks, so long runs stay in bounded memory. Slices of
+// the same track nest, because an ID is only reused after its response.
+
+#define TIMELINE_TID_ID		100		// track of AxID 0, the others follow
+
+class AXI_TIMELINE
+{
+public:
+	bool open(const std::string& filename);
+	void close();
+	bool is_open() const { return f_out.is_open(); }
+
+	// a process of the timeline, e.g. one bus
+	int add_process(const std::string& name);
+	void name_track(int pid, int tid, const std::string& name);
+
+	// at the current simulation time
+	void begin(int pid, int tid, const std::string& name, const std::string& detail = "");
+	void end(int pid, int tid);
+	void complete(int pid, int tid, const std::string& name, uint64_t duration_ns,
+		const std::string& detail = "");
+
+	uint64_t count_event = 0;
+
+private:
+	std::string filename;
+	std::ofstream f_out;
+	int count_process = 0;
+	std::set<std::pair<int, int>> set_named;
+
+	void write_head(const char* phase, int pid, int tid);
+	static std::string stamp_to_us(uint64_t stamp_ns);
+	static std::string escape(const std::string& s);
+};
+
+#endif
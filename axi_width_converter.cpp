@@ -0,0 +1,326 @@
+#include <iostream>
+#include <systemc>
+#include <string>
+#include <algorithm>
+
+using namespace sc_core;
+using namespace sc_dt;
+
+#include "axi_width_converter.h"
+#include "axi_checkpoint.h"
+
+// 4KiB, a burst must not cross this boundary (Chapter A3.4.1)
+#define AXI_BOUNDARY_BYTES	4096
+
+void AXI_WIDTH_CONVERTER::end_of_elaboration()
+{
+	const int widths[] = {width_up, width_down};
+
+	for (int width : widths)
+	{
+		if (width < 8 || width > DATA_WIDTH || (width & (width - 1)) != 0)
+		{
+			SC_REPORT_FATAL("AXI_WIDTH_CONVERTER", ("Invalid width " + std::to_string(width)).c_str());
+		}
+	}
+}
+
+void AXI_WIDTH_CONVERTER::thread_request()
+{
+	while(true)
+	{
+		fifo_request();
+	}
+}
+
+void AXI_WIDTH_CONVERTER::thread_response()
+{
+	while(true)
+	{
+		fifo_response();
+	}
+}
+
+int AXI_WIDTH_CONVERTER::count_bytes(bus_strb_t strb)
+{
+	int count = 0;
+	for (; strb; strb >>= 1)
+	{
+		count += strb & 1;
+	}
+	return count;
+}
+
+// Cut every upstream beat at the downstream beat boundaries.
+// Neighbouring pieces in the same downstream beat are merged.
+
+std::vector<conversion_beat_t> AXI_WIDTH_CONVERTER::split_beats(const axi_trans_t& trans)
+{
+	std::vector<conversion_beat_t> beats;
+	uint64_t bytes_down = width_down / 8;
+	uint8_t size_down = axi_size_from_bytes(bytes_down);
+
+	for (int i = 0; i < trans.length; i++)
+	{
+		uint64_t addr_beat = axi_beat_address(trans.addr, trans.burst, trans.size, trans.length, i);
+		bus_strb_t strb = axi_beat_strobe(addr_beat, trans.size);
+		if (trans.is_write)
+		{
+			strb &= trans.strb[i];
+		}
+
+		uint64_t addr_first = (addr_beat / bytes_down) * bytes_down;
+		uint64_t addr_end = (addr_beat / (1ULL << trans.size) + 1) * (1ULL << trans.size);
+		for (uint64_t addr = addr_first; addr < addr_end; addr += bytes_down)
+		{
+			bus_strb_t strb_piece = strb & axi_beat_strobe(addr, size_down);
+
+			if (!beats.empty() && beats.back().addr == addr)
+			{
+				// upsizing, one more narrow beat in the same wide beat
+				conversion_beat_t& last = beats.back();
+				last.data = bus_data_merge(last.data, trans.data[i], strb_piece);
+				last.strb |= strb_piece;
+				continue;
+			}
+
+			conversion_beat_t beat;
+			beat.addr = addr;
+			beat.data = trans.data[i];
+			beat.strb = strb_piece;
+			beats.push_back(beat);
+		}
+	}
+	return beats;
+}
+
+// Pack downstream beats at consecutive addresses into INCR bursts.
+
+std::vector<axi_trans_t> AXI_WIDTH_CONVERTER::pack_beats(const std::vector<conversion_beat_t>& beats, bool is_write)
+{
+	std::vector<axi_trans_t> parts;
+	uint64_t bytes_down = width_down / 8;
+	axi_trans_t trans;
+
+	trans.length = 0;
+	for (const conversion_beat_t& beat : beats)
+	{
+		bool is_contiguous = (trans.length > 0)
+			&& (beat.addr == trans.addr + bytes_down * trans.length)
+			&& (trans.length < AXI_TRANSACTION_LENGTH_MAX)
+			&& (beat.addr % AXI_BOUNDARY_BYTES != 0);
+
+		if (!is_contiguous)
+		{
+			if (trans.length > 0)
+			{
+				parts.push_back(trans);
+			}
+			trans.addr = beat.addr;
+			trans.length = 0;
+			trans.burst = AXI_BURST_INCR;
+			trans.size = axi_size_from_bytes(bytes_down);
+			trans.is_write = is_write;
+		}
+
+		trans.data[trans.length] = beat.data;
+		trans.strb[trans.length] = beat.strb;
+		trans.length ++;
+	}
+
+	if (trans.length > 0)
+	{
+		parts.push_back(trans);
+	}
+	return parts;
+}
+
+void AXI_WIDTH_CONVERTER::convert(conversion_t& conversion)
+{
+	const axi_trans_t& trans = *conversion.trans;
+	std::vector<conversion_beat_t> beats = split_beats(trans);
+
+	conversion.parts = pack_beats(beats, trans.is_write);
+	conversion.is_part_done.assign(conversion.parts.size(), false);
+	conversion.count_remaining = conversion.parts.size();
+
+	count_trans_up ++;
+	count_beat_up += trans.length;
+	count_bytes_capacity_up += (uint64_t) trans.length * (width_up / 8);
+	count_trans_down += conversion.parts.size();
+	count_beat_down += beats.size();
+	count_bytes_capacity_down += (uint64_t) beats.size() * (width_down / 8);
+	for (const conversion_beat_t& beat : beats)
+	{
+		count_bytes_useful += count_bytes(beat.strb);
+	}
+}
+
+void AXI_WIDTH_CONVERTER::fifo_request()
+{
+	std::string log_detail;
+	conversion_t conversion;
+
+	// blocking read
+	conversion.trans = request_in.read();
+	log(__FUNCTION__, "GOT_REQUEST", AXI_BUS::transaction_to_string(*conversion.trans));
+
+	convert(conversion);
+	q_conversion.push_back(conversion);
+
+	log_detail = "parts=" + std::to_string(conversion.parts.size())
+		+ ", " + AXI_BUS::transaction_to_string(*conversion.trans);
+	log(__FUNCTION__, "CONVERTED", log_detail);
+
+	// Do not hold a reference into q_conversion, writes may block.
+	std::vector<axi_trans_handle_t> parts;
+	for (const axi_trans_t& part : conversion.parts)
+	{
+		parts.push_back(axi_trans_alloc(part));
+	}
+	for (axi_trans_handle_t part : parts)
+	{
+		request_out.write(part);
+		log(__FUNCTION__, "SENT_REQUEST", AXI_BUS::transaction_to_string(*part));
+	}
+}
+
+// Build the upstream response when all parts are back.
+
+void AXI_WIDTH_CONVERTER::finish(conversion_t& conversion)
+{
+	axi_trans_t& trans = *conversion.trans;
+
+	if (!trans.is_write)
+	{
+		for (int i = 0; i < trans.length; i++)
+		{
+			uint64_t addr_beat = axi_beat_address(trans.addr, trans.burst, trans.size, trans.length, i);
+			trans.data[i] = conversion.map_data[axi_word_address(addr_beat)];
+		}
+	}
+
+	response_out.write(conversion.trans);
+	log(__FUNCTION__, "SENT_RESPONSE", AXI_BUS::transaction_to_string(trans));
+}
+
+void AXI_WIDTH_CONVERTER::fifo_response()
+{
+	// blocking read, the data is merged into the conversion
+	axi_trans_handle_t handle = response_in.read();
+	const axi_trans_t& part = *handle;
+	log(__FUNCTION__, "GOT_RESPONSE", AXI_BUS::transaction_to_string(part));
+
+	// The bus returns the part as it was sent, find the oldest one.
+	for (auto iter = q_conversion.begin(); iter != q_conversion.end(); iter++)
+	{
+		for (size_t i = 0; i < iter->parts.size(); i++)
+		{
+			const axi_trans_t& sent = iter->parts[i];
+			if (iter->is_part_done[i] || sent.addr != part.addr || sent.is_write != part.is_write)
+			{
+				continue;
+			}
+
+			iter->is_part_done[i] = true;
+			iter->count_remaining --;
+			if (!part.is_write)
+			{
+				for (int beat = 0; beat < part.length; beat++)
+				{
+					uint64_t addr_beat = axi_beat_address(part.addr, part.burst, part.size, part.length, beat);
+					uint64_t addr = axi_word_address(addr_beat);
+					bus_strb_t strb = axi_beat_strobe(addr_beat, part.size);
+					iter->map_data[addr] = bus_data_merge(iter->map_data[addr], part.data[beat], strb);
+				}
+			}
+
+			if (iter->count_remaining == 0)
+			{
+				conversion_t conversion = *iter;
+				q_conversion.erase(iter);
+				finish(conversion);
+			}
+			axi_trans_free(handle);
+			return;
+		}
+	}
+
+	log(__FUNCTION__, "NOT_IN_PROGRESS", AXI_BUS::transaction_to_string(part));
+	SC_REPORT_FATAL("AXI_WIDTH_CONVERTER", "Response, not in progress");
+}
+
+void AXI_WIDTH_CONVERTER::report_stats()
+{
+	std::cout << "CONVERTER " << name() << ": width=" << width_up << "->" << width_down
+		<< ", transactions=" << count_trans_up << "->" << count_trans_down
+		<< ", beats=" << count_beat_up << "->" << count_beat_down << std::endl;
+	if (count_bytes_capacity_down > 0)
+	{
+		std::cout << "CONVERTER " << name() << ": useful_bytes=" << count_bytes_useful
+			<< ", efficiency_up=" << (double) count_bytes_useful / count_bytes_capacity_up
+			<< ", efficiency_down=" << (double) count_bytes_useful / count_bytes_capacity_down
+			<< std::endl;
+	}
+}
+
+// A drained converter has no state, only its widths are checked.
+
+void AXI_WIDTH_CONVERTER::save_state(AXI_CHECKPOINT& checkpoint)
+{
+	if (!is_idle())
+	{
+		SC_REPORT_FATAL("AXI_WIDTH_CONVERTER", "Checkpoint with transactions in flight");
+	}
+
+	checkpoint.put_tag("WIDTH_CONVERTER:" + std::string(name()));
+	checkpoint.put_uint(width_up);
+	checkpoint.put_uint(width_down);
+}
+
+void AXI_WIDTH_CONVERTER::restore_state(AXI_CHECKPOINT& checkpoint)
+{
+	checkpoint.expect_tag("WIDTH_CONVERTER:" + std::string(name()));
+	if ((int) checkpoint.get_uint() != width_up || (int) checkpoint.get_uint() != width_down)
+	{
+		SC_REPORT_FATAL("AXI_WIDTH_CONVERTER", "Checkpoint of other widths");
+	}
+}
+
+// Between the workloads of a batch, with all traffic drained.
+
+void AXI_WIDTH_CONVERTER::soft_reset()
+{
+	q_conversion.clear();
+
+	count_trans_up = 0;
+	count_trans_down = 0;
+	count_beat_up = 0;
+	count_beat_down = 0;
+	count_bytes_useful = 0;
+	count_bytes_capacity_up = 0;
+	count_bytes_capacity_down = 0;
+}
+
+bool AXI_WIDTH_CONVERTER::is_idle()
+{
+	return q_conversion.empty() && request_in->num_available() == 0
+		&& response_in->num_available() == 0;
+}
+
+void AXI_WIDTH_CONVERTER::report_outstanding()
+{
+	std::cout << "CONVERTER " << name() << ": conversions=" << q_conversion.size() << std::endl;
+	for (const conversion_t& conversion : q_conversion)
+	{
+		std::cout << "CONVERTER " << name() << ":   "
+			<< AXI_BUS::transaction_to_string(*conversion.trans) << std::endl;
+	}
+}
+
+void AXI_WIDTH_CONVERTER::log(std::string source, std::string action, std::string detail)
+{
+	std::string sep = ":";
+	std::string log_source = "CONVERTER" + sep + name() + sep + source;
+	AXI_BUS::log(log_source, action, detail);
+}
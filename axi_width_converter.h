@@ -0,0 +1,95 @@
+#ifndef __AXI_WIDTH_CONVERTER_H__
+#define __AXI_WIDTH_CONVERTER_H__
+
+#include <systemc>
+#include <deque>
+#include <vector>
+#include <string>
+#include <unordered_map>
+
+#include "axi_param.h"
+#include "axi_bus.h"
+
+// Every bus segment carries bus_data_t, DATA_WIDTH bits wide, with the
+// bytes on their lanes. The width of a segment is the largest beat it
+// moves, so a narrower segment is modeled with narrow transfers (AxSIZE).
+
+// one beat of the downstream segment
+typedef struct
+{
+	uint64_t	addr;	// aligned to the downstream beat size
+	bus_data_t	data;
+	bus_strb_t	strb;
+} conversion_beat_t;
+
+// an upstream transaction, converted into downstream ones
+typedef struct
+{
+	axi_trans_handle_t			trans;	// the request, back as its response
+	std::vector<axi_trans_t>	parts;
+	std::vector<bool>			is_part_done;
+	int							count_remaining;
+
+	// read data of the parts, by bus word address
+	std::unordered_map<uint64_t, bus_data_t>	map_data;
+} conversion_t;
+
+class AXI_CHECKPOINT;
+
+// Data width converter between two bus segments.
+// Upstream faces the request_S/response_S of the manager side bus,
+// downstream faces the request_M/response_M of the subordinate side bus.
+// Beats are split (downsizing) or merged (upsizing) to the downstream
+// width, then packed into INCR bursts.
+
+SC_MODULE(AXI_WIDTH_CONVERTER)
+{
+	sc_fifo_in<axi_trans_handle_t> request_in;
+	sc_fifo_out<axi_trans_handle_t> response_out;
+	sc_fifo_out<axi_trans_handle_t> request_out;
+	sc_fifo_in<axi_trans_handle_t> response_in;
+
+	// width of the segments in bits, power of 2, up to DATA_WIDTH
+	int width_up = DATA_WIDTH;
+	int width_down = DATA_WIDTH;
+
+	std::deque<conversion_t> q_conversion;
+
+	// statistics
+	uint64_t count_trans_up = 0;
+	uint64_t count_trans_down = 0;
+	uint64_t count_beat_up = 0;
+	uint64_t count_beat_down = 0;
+	uint64_t count_bytes_useful = 0;		// strobed bytes
+	uint64_t count_bytes_capacity_up = 0;	// beats * width
+	uint64_t count_bytes_capacity_down = 0;
+
+	SC_CTOR(AXI_WIDTH_CONVERTER)
+	{
+		SC_THREAD(thread_request);
+		SC_THREAD(thread_response);
+	}
+
+	void end_of_elaboration() override;
+
+	void thread_request();
+	void thread_response();
+	void fifo_request();
+	void fifo_response();
+
+	std::vector<conversion_beat_t> split_beats(const axi_trans_t& trans);
+	std::vector<axi_trans_t> pack_beats(const std::vector<conversion_beat_t>& beats, bool is_write);
+	void convert(conversion_t& conversion);
+	void finish(conversion_t& conversion);
+
+	static int count_bytes(bus_strb_t strb);
+	void report_stats();
+	void soft_reset();
+	void save_state(AXI_CHECKPOINT& checkpoint);
+	void restore_state(AXI_CHECKPOINT& checkpoint);
+	bool is_idle();
+	void report_outstanding();
+	void log(std::string source, std::string action, std::string detail);
+};
+
+#endif
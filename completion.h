@@ -0,0 +1,113 @@
+#ifndef __COMPLETION_H__
+#define __COMPLETION_H__
+
+#include <systemc>
+#include <iostream>
+#include <vector>
+#include <string>
+#include <functional>
+
+// Stops the simulation when every watched module is idle, i.e. all traffic
+// has drained. A module is watched when it has is_idle() and
+// report_outstanding(). The check runs at each rising clock edge and must
+// hold for count_idle_clocks edges in a row, because a transaction written
+// into an sc_fifo is not visible until the next update phase.
+// At limit_ns the simulation stops anyway and the modules report what
+// is still outstanding.
+//
+// In batch mode (is_pausing) a drained run pauses the simulation with
+// sc_pause() instead, and sc_main starts the next workload with restart()
+// and sc_start(). limit_ns then counts from the start of each workload.
+// A timeout still stops the simulation, because the modules are not idle
+// and cannot be reset safely.
+
+SC_MODULE(COMPLETION)
+{
+	sc_in<bool>	ACLK;
+
+	uint64_t limit_ns = 0;		// 0 is no limit
+	int count_idle_clocks = 2;
+	bool is_pausing = false;
+	uint64_t stamp_start_ns = 0;
+
+	bool is_completed = false;
+	bool is_timeout = false;
+	uint64_t stamp_stop_ns = 0;
+
+	std::vector<std::function<bool()>> list_is_idle;
+	std::vector<std::function<void()>> list_report;
+
+	SC_CTOR(COMPLETION)
+	{
+		SC_THREAD(thread_execute);
+	}
+
+	template <typename T>
+	void watch(T& module)
+	{
+		list_is_idle.push_back([&module]() { return module.is_idle(); });
+		list_report.push_back([&module]() { module.report_outstanding(); });
+	}
+
+	// before sc_start() of the next workload
+	void restart()
+	{
+		is_completed = false;
+		stamp_start_ns = sc_time_stamp().value() / 1000; // ps to ns convert.
+		stamp_stop_ns = 0;
+	}
+
+	bool is_all_idle()
+	{
+		for (auto& is_idle : list_is_idle)
+		{
+			if (!is_idle())
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	void thread_execute()
+	{
+		int count_idle = 0;
+
+		while (true)
+		{
+			wait(ACLK.posedge_event());
+			uint64_t stamp_now_ns = sc_time_stamp().value() / 1000; // ps to ns convert.
+
+			count_idle = is_all_idle() ? count_idle + 1 : 0;
+			if (count_idle >= count_idle_clocks)
+			{
+				is_completed = true;
+				stamp_stop_ns = stamp_now_ns;
+				std::cout << "COMPLETION: all traffic drained at " << stamp_now_ns << " ns" << std::endl;
+				if (is_pausing)
+				{
+					count_idle = 0;
+					sc_pause();
+					continue;
+				}
+				sc_stop();
+				return;
+			}
+
+			if (limit_ns > 0 && stamp_now_ns >= stamp_start_ns + limit_ns)
+			{
+				is_timeout = true;
+				stamp_stop_ns = stamp_now_ns;
+				std::cout << "COMPLETION: time limit " << limit_ns << " ns reached, outstanding:" << std::endl;
+				for (auto& report : list_report)
+				{
+					report();
+				}
+				sc_stop();
+				return;
+			}
+		}
+	}
+};
+
+#endif
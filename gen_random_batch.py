@@ -0,0 +1,49 @@
+#!/usr/bin/env python3
+import os
+import random
+import sys
+import gen_random_access
+import compare_memory
+
+# Random workloads for the batch mode of project.exe, see make batch-test.
+# batch/batch.csv lists them as
+# access, memory, m_memory_after, s_memory_after
+
+DIRECTORY = "batch"
+FILENAME_BATCH = os.path.join(DIRECTORY, "batch.csv")
+
+def filenames(i):
+	prefix = os.path.join(DIRECTORY, "w%04d_" % i)
+	return [prefix + name for name in
+		["m_access.csv", "s_memory.csv", "m_memory_after.csv", "s_memory_after.csv"]]
+
+def gen_random_batch(n=100):
+	os.makedirs(DIRECTORY, exist_ok=True)
+	f_batch = open(FILENAME_BATCH, "w")
+	for i in range(n):
+		(access, memory, m_after, s_after) = filenames(i)
+		gen_random_access.gen_random_access(filename_access=access, filename_memory=memory,
+			mode="any", length_max=random.randint(1, 16), is_length_variable=True,
+			stamp_start=random.randint(100, 500), stamp_step_min=random.randint(1, 10),
+			n=random.randint(1, 200))
+		f_batch.write("{},{},{},{}\n".format(access, memory, m_after, s_after))
+	f_batch.close()
+
+def check_random_batch():
+	count_fail = 0
+	f_batch = open(FILENAME_BATCH)
+	for line in f_batch:
+		(access, memory, m_after, s_after) = line.strip().split(",")
+		print(access)
+		if compare_memory.compare_memory(access, m_after, s_after):
+			count_fail += 1
+	f_batch.close()
+	print("failed %d workloads" % count_fail)
+	return count_fail
+
+if __name__ == '__main__':
+	if len(sys.argv) > 1 and sys.argv[1] == "check":
+		sys.exit(1 if check_random_batch() else 0)
+	random.seed(0)  # for reproducibility
+	n = int(sys.argv[1]) if len(sys.argv) > 1 else 100
+	gen_random_batch(n)
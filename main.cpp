@@ -1,58 +1,213 @@
 #include <iostream>
+#include <chrono>
+#include <memory>
+#include <vector>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <unordered_map>
 #include <systemc>
+#include <unistd.h>
+#include <sys/wait.h>
 
 using namespace sc_core;
 using namespace sc_dt;
 
-#define SIMULATION_TIME	100000
+// The topology, sizes, latencies and file names are read at run time,
+// see axi_sim.ini and project.exe --help. Without any setting the run is
+// M1 -> bus -> S1 with the CSV files of this directory.
 
+#include "axi_config.h"
+#include "axi_checkpoint.h"
 #include "axi_bus.h"
 #include "axi_manager.h"
 #include "axi_subordinate.h"
+#include "axi_dram.h"
+#include "axi_width_converter.h"
+#include "axi_cache.h"
+#include "axi_prefetcher.h"
+#include "axi_bridge.h"
+#include "axi_ensemble.h"
+#include "axi_timeline.h"
+#include "axi_fifo.h"
 #include "resetter.h"
+#include "completion.h"
 
-int sc_main(int, char*[])
+// one workload of a batch
+typedef struct
 {
-	sc_clock ACLK("ACLK", 1, SC_NS);
-	sc_signal<bool> ARESETn;
-	
-	sc_fifo<axi_trans_t> request_M;
-	sc_fifo<axi_trans_t> request_S;
-	sc_fifo<axi_trans_t> response_M;
-	sc_fifo<axi_trans_t> response_S;
+	std::string	filename_access;
+	std::string	filename_memory;
+	std::string	filename_m_after;	// empty is not written
+	std::string	filename_s_after;
+} workload_t;
 
-	AXI_BUS bus("bus");
-	AXI_MANAGER m("M1");
-	AXI_SUBORDINATE s("S1");
-	RESETTER r("r");
-	
-	r.ARESETn(ARESETn);
+bool read_batch_csv(const std::string& filename, std::vector<workload_t>& list_workload)
+{
+	std::ifstream f(filename);
+	if (!f.is_open())
+	{
+		std::cerr << "Error: could not open " << filename << std::endl;
+		return false;
+	}
 
-	bus.ACLK(ACLK);
-	bus.ARESETn(ARESETn);
-	bus.request_M(request_M);
-	bus.response_M(response_M);
-	bus.response_S(response_S);
-	bus.request_S(request_S);
+	int line_number = 1;
+	std::string line;
+	while (std::getline(f, line))
+	{
+		// line format
+		// access, memory[, m_memory_after[, s_memory_after]]
+		//
+		// access: file name, access trace of the manager
+		// memory: file name, initial memory image of the subordinate
+		// m_memory_after, s_memory_after: file names, optional,
+		//     memory images written after the workload
+		//
+		// empty lines and lines starting with '#' are ignored.
 
-	m.request(request_M);
-	m.response(response_M);
+		if (line.empty() || line[0] == '#')
+		{
+			line_number ++;
+			continue;
+		}
+
+		std::istringstream iss(line);
+		workload_t workload;
+		std::getline(iss, workload.filename_access, ',');
+		std::getline(iss, workload.filename_memory, ',');
+		std::getline(iss, workload.filename_m_after, ',');
+		std::getline(iss, workload.filename_s_after, ',');
+		std::string rest;
+		if (workload.filename_access.empty() || workload.filename_memory.empty()
+			|| std::getline(iss, rest, ','))
+		{
+			std::cerr << "Error: invalid format in " << filename << std::endl;
+			std::cerr << "At line (" << line_number << "): " << line << std::endl;
+			SC_REPORT_FATAL("AXI_CONFIG", ("Invalid workload list " + filename).c_str());
+		}
+		list_workload.push_back(workload);
+		line_number ++;
+	}
+	return !list_workload.empty();
+}
+
+// READY generator from "always", "random:P", "periodic:PERIOD:DUTY" or "credit:N"
+
+ready_policy_t parse_ready_policy(const std::string& key, const std::string& value)
+{
+	ready_policy_t policy = {READY_ALWAYS, 0, 0, 0, 0};
+	std::istringstream iss(value);
+	std::string mode, token1, token2;
+
+	std::getline(iss, mode, ':');
+	std::getline(iss, token1, ':');
+	std::getline(iss, token2, ':');
+
+	try
+	{
+		if (mode == "always")
+		{
+			return policy;
+		}
+		// a policy that never asserts READY deadlocks the bus
+		if (mode == "random" && !token1.empty())
+		{
+			policy.mode = READY_RANDOM;
+			policy.probability = std::stod(token1);
+			if (policy.probability > 0 && policy.probability <= 1)
+			{
+				return policy;
+			}
+		}
+		if (mode == "periodic" && !token1.empty() && !token2.empty())
+		{
+			policy.mode = READY_PERIODIC;
+			policy.period = std::stoul(token1);
+			policy.duty = std::stoul(token2);
+			if (policy.period == 0 || policy.duty > 0)
+			{
+				return policy;
+			}
+		}
+		if (mode == "credit" && !token1.empty())
+		{
+			policy.mode = READY_CREDIT;
+			policy.credits = std::stoul(token1);
+			if (policy.credits > 0)
+			{
+				return policy;
+			}
+		}
+	}
+	catch (const std::exception&)
+	{
+	}
+
+	SC_REPORT_FATAL("AXI_CONFIG", ("Invalid READY policy: " + key + "=" + value).c_str());
+	return policy;
+}
+
+void configure_bus(AXI_BUS& bus, AXI_CONFIG& config, const std::string& section)
+{
+	const int channels[] = {CHANNEL_AW, CHANNEL_W, CHANNEL_B, CHANNEL_AR, CHANNEL_R};
+
+	// READY generator of the receiving channels, e.g. ready_r = random:0.5
+	for (int channel : channels)
+	{
+		std::string name = AXI_BUS::get_channel_name(channel);
+		std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+		std::string key = section + ".ready_" + name;
+		std::string value = config.get_string(key, "always");
+		bus.set_ready_policy(channel, parse_ready_policy(key, value));
+	}
+	bus.set_seed(config.get_int(section + ".seed", 0));
 
-	s.request(request_S);
-	s.response(response_S);
+	// width of AxID, 2^id_width transactions at most in flight
+	bus.id_width = config.get_int(section + ".id_width", bus.id_width, 1, 16);
 
-	sc_trace_file* f = sc_create_vcd_trace_file("trace");
-	sc_trace(f, ARESETn, "ARESETn");
-	sc_trace(f, ACLK, "ACLK");
+	// channel queue depths, in beats
+	bus.depth_queue_addr = config.get_int(section + ".depth_queue_addr", bus.depth_queue_addr, 1, 65536);
+	bus.depth_queue_data = config.get_int(section + ".depth_queue_data", bus.depth_queue_data, 1, 65536);
+	bus.depth_queue_resp = config.get_int(section + ".depth_queue_resp", bus.depth_queue_resp, 1, 65536);
+
+	// bufferable writes, early B response and write combining
+	bus.is_write_buffered = config.get_bool(section + ".write_buffered", bus.is_write_buffered);
+	bus.depth_write_buffer = config.get_int(section + ".depth_write_buffer", bus.depth_write_buffer);
+	bus.write_buffer_timeout_ns = config.get_int(section + ".write_buffer_timeout_ns", bus.write_buffer_timeout_ns);
+}
+
+void trace_bus(sc_trace_file* f, AXI_BUS& bus)
+{
+#ifdef AXI_BUS_BUNDLED_SIGNALS
+	// the payload signals trace their fields, e.g. AW as AWID, AWADDR, ...
+	sc_trace(f, bus.AWVALID, "AWVALID");
+	sc_trace(f, bus.AWREADY, "AWREADY");
+	sc_trace(f, bus.AW, "AW");
+	sc_trace(f, bus.WVALID, "WVALID");
+	sc_trace(f, bus.WREADY, "WREADY");
+	sc_trace(f, bus.W, "W");
+	sc_trace(f, bus.BVALID, "BVALID");
+	sc_trace(f, bus.BREADY, "BREADY");
+	sc_trace(f, bus.B, "B");
+	sc_trace(f, bus.ARVALID, "ARVALID");
+	sc_trace(f, bus.ARREADY, "ARREADY");
+	sc_trace(f, bus.AR, "AR");
+	sc_trace(f, bus.RVALID, "RVALID");
+	sc_trace(f, bus.RREADY, "RREADY");
+	sc_trace(f, bus.R, "R");
+#else
 	sc_trace(f, bus.AWVALID, "AWVALID");
 	sc_trace(f, bus.AWREADY, "AWREADY");
 	sc_trace(f, bus.AWID, "AWID");
 	sc_trace(f, bus.AWADDR, "AWADDR");
 	sc_trace(f, bus.AWLEN, "AWLEN");
+	sc_trace(f, bus.AWSIZE, "AWSIZE");
+	sc_trace(f, bus.AWBURST, "AWBURST");
 	sc_trace(f, bus.WVALID, "WVALID");
 	sc_trace(f, bus.WREADY, "WREADY");
 	sc_trace(f, bus.WID, "WID");
 	sc_trace(f, bus.WDATA, "WDATA");
+	sc_trace(f, bus.WSTRB, "WSTRB");
 	sc_trace(f, bus.WLAST, "WLAST");
 	sc_trace(f, bus.BVALID, "BVALID");
 	sc_trace(f, bus.BREADY, "BREADY");
@@ -62,20 +217,782 @@ int sc_main(int, char*[])
 	sc_trace(f, bus.ARID, "ARID");
 	sc_trace(f, bus.ARADDR, "ARADDR");
 	sc_trace(f, bus.ARLEN, "ARLEN");
+	sc_trace(f, bus.ARSIZE, "ARSIZE");
+	sc_trace(f, bus.ARBURST, "ARBURST");
 	sc_trace(f, bus.RVALID, "RVALID");
 	sc_trace(f, bus.RREADY, "RREADY");
 	sc_trace(f, bus.RID, "RID");
 	sc_trace(f, bus.RDATA, "RDATA");
 	sc_trace(f, bus.RLAST, "RLAST");
+#endif
+}
+
+int sc_main(int argc, char* argv[])
+{
+	AXI_CONFIG config;
+	if (!config.parse_args(argc, argv))
+	{
+		return (1);
+	}
+	if (config.report_unknown() > 0)
+	{
+		SC_REPORT_FATAL("AXI_CONFIG", "Unknown settings");
+	}
+
+	// Hard limit of the simulation in nano seconds. The simulation stops
+	// earlier, as soon as all traffic has drained. 0 is no limit.
+	uint64_t limit_ns = config.get_int("simulation.limit_ns", 100000);
+	std::string filename_vcd = config.get_string("simulation.vcd", "trace");
+	std::string filename_timeline = config.get_string("simulation.timeline", "");
+
+	// Ensemble: the workloads of the batch spread over this many worker
+	// processes. 0 runs them one after the other in this process.
+	int count_worker = config.get_int("simulation.workers", 0);
+
+	AXI_BUS::is_debug = config.get_bool("debug.bus", AXI_BUS::is_debug);
+	AXI_BUS::is_debug_channel = config.get_bool("debug.channel", AXI_BUS::is_debug_channel);
+	AXI_BUS::is_debug_progress = config.get_bool("debug.progress", AXI_BUS::is_debug_progress);
+
+	// Partitioned simulation: the manager side (M1 and the bus) and the
+	// subordinate side (the stages and S1) run in two processes, linked by
+	// a bridge over shared memory. Both processes elaborate the whole model,
+	// the modules of the other side get no clock and no traffic.
+	bool is_partitioned = config.get_bool("partition.enable", false);
+	uint64_t lookahead_ns = config.get_int("partition.lookahead_ns", 1);
+	int partition = 0;
+	bridge_shared_t* shared = nullptr;
+	pid_t pid_child = 0;
+	if (is_partitioned)
+	{
+		if (!config.get_string("simulation.batch", "").empty()
+			|| !config.get_string("simulation.checkpoint", "").empty()
+			|| !config.get_string("simulation.restore", "").empty()
+			|| config.get_int("sampling.period", 0) > 0)
+		{
+			SC_REPORT_FATAL("AXI_CONFIG", "Partitioned simulation does not work with batch,"
+				" checkpoints or sampling");
+		}
+
+		shared = AXI_BRIDGE::create_shared();
+		shared->pid[0] = getpid();
+		std::cout.flush();
+		pid_child = fork();
+		if (pid_child < 0)
+		{
+			SC_REPORT_FATAL("AXI_BRIDGE", "Cannot fork the subordinate side");
+		}
+		partition = (pid_child == 0) ? 1 : 0;
+		// both, neither side waits for the other to set it
+		shared->pid[1] = (pid_child == 0) ? getpid() : pid_child;
+	}
+	bool is_manager_side = !is_partitioned || partition == 0;
+	bool is_subordinate_side = !is_partitioned || partition == 1;
+
+	sc_clock ACLK("ACLK", 1, SC_NS);
+	sc_signal<bool> ARESETn;
+	sc_signal<bool> ACLK_inert;
+	sc_signal<bool>& ACLK_manager = is_manager_side ? ACLK : ACLK_inert;
+	sc_signal<bool>& ACLK_subordinate = is_subordinate_side ? ACLK : ACLK_inert;
+
+	// Depths of the transaction fifos. A slot holds a whole burst, and
+	// a producer runs at most depth transactions ahead of its consumer.
+	int depth_request_M = config.get_int("fifo.request_M", 16, 1, AXI_FIFO_DEPTH_MAX);
+	int depth_response_M = config.get_int("fifo.response_M", 16, 1, AXI_FIFO_DEPTH_MAX);
+	int depth_request_S = config.get_int("fifo.request_S", 16, 1, AXI_FIFO_DEPTH_MAX);
+	int depth_response_S = config.get_int("fifo.response_S", 16, 1, AXI_FIFO_DEPTH_MAX);
+	int depth_stage = config.get_int("fifo.stage", 16, 1, AXI_FIFO_DEPTH_MAX);
+
+	AXI_FIFO<axi_trans_handle_t> request_M("request_M", depth_request_M);
+	AXI_FIFO<axi_trans_handle_t> request_S("request_S", depth_request_S);
+	AXI_FIFO<axi_trans_handle_t> response_M("response_M", depth_response_M);
+	AXI_FIFO<axi_trans_handle_t> response_S("response_S", depth_response_S);
+
+	AXI_BUS bus("bus");
+	AXI_MANAGER m("M1");
+	RESETTER r("r");
+
+	r.ARESETn(ARESETn);
+
+	bus.ACLK(ACLK_manager);
+	bus.ARESETn(ARESETn);
+	bus.request_M(request_M);
+	bus.response_M(response_M);
+	bus.response_S(response_S);
+	bus.request_S(request_S);
+	configure_bus(bus, config, "bus");
+
+	// closed loop manager, issue limited by outstanding transactions
+	// and dependencies of the trace. 0 is unlimited.
+	m.filename_access = config.get_string("manager.access", m.filename_access);
+	m.is_closed_loop = config.get_bool("manager.closed_loop", m.is_closed_loop);
+	m.max_outstanding_read = config.get_int("manager.max_outstanding_read", m.max_outstanding_read);
+	m.max_outstanding_write = config.get_int("manager.max_outstanding_write", m.max_outstanding_write);
+
+	// merge contiguous single-beat accesses within the window into bursts
+	m.is_coalescing = config.get_bool("manager.coalescing", m.is_coalescing);
+	m.coalesce_window_ns = config.get_int("manager.coalesce_window_ns", 10);
+	std::string filename_m_after = config.get_string("manager.memory_after", "m_memory_after.csv");
+
+	// sampled simulation, in accesses of the trace. period 0 is off.
+	m.sampler.period = config.get_int("sampling.period", 0);
+	m.sampler.warmup = config.get_int("sampling.warmup", 0);
+	m.sampler.window = config.get_int("sampling.window", 0);
+	m.sampler.confidence = config.get_double("sampling.confidence", m.sampler.confidence);
+	if (!m.sampler.is_valid())
+	{
+		SC_REPORT_FATAL("AXI_CONFIG", "Invalid sampling, needs 0 < window, warmup + window <= period"
+			" and confidence 0.90, 0.95 or 0.99");
+	}
+
+	m.request(request_M);
+	m.response(response_M);
+
+	// subordinate model, "simple" or "dram"
+	std::string model = config.get_string("subordinate.model", "simple");
+	std::unique_ptr<AXI_SUBORDINATE> s_model;
+	AXI_SUBORDINATE_DRAM* s_dram = nullptr;
+	if (model == "dram")
+	{
+		s_dram = new AXI_SUBORDINATE_DRAM("S1");
+		s_dram->filename_dram = config.get_string("subordinate.dram", s_dram->filename_dram);
+		s_model.reset(s_dram);
+	}
+	else if (model == "simple")
+	{
+		s_model.reset(new AXI_SUBORDINATE("S1"));
+	}
+	else
+	{
+		SC_REPORT_FATAL("AXI_CONFIG", ("Unknown subordinate.model " + model).c_str());
+	}
+	AXI_SUBORDINATE& s = *s_model;
+
+	s.filename_memory = config.get_string("subordinate.memory", s.filename_memory);
+	s.filename_latency = config.get_string("subordinate.latency", s.filename_latency);
+	std::string filename_s_after = config.get_string("subordinate.memory_after", "s_memory_after.csv");
+
+	// service slots and request queue depth of the subordinate.
+	// 0 is unlimited. When both are full, the bus deasserts READY.
+	s.count_slot_max = config.get_int("subordinate.slots", s.count_slot_max);
+	s.depth_request_max = config.get_int("subordinate.depth_request", s.depth_request_max);
+	s.is_unmapped_zero = config.get_bool("subordinate.unmapped_zero", s.is_unmapped_zero);
+	s.set_seed(config.get_int("subordinate.seed", s.seed, 0, UINT32_MAX));
+
+	// The optional stages between the bus and the subordinate, in order:
+	// bus -> C1 -> bus_down -> L3 -> P1 -> S1
+	// Partitioned, the bridge cuts the chain right behind the bus:
+	// bus -> B1 | B1 -> C1 -> ...
+	std::vector<std::unique_ptr<AXI_FIFO<axi_trans_handle_t>>> list_fifo;
+	AXI_FIFO<axi_trans_handle_t>* request_tail = &request_S;
+	AXI_FIFO<axi_trans_handle_t>* response_tail = &response_S;
+	AXI_FIFO<axi_trans_handle_t> request_P("request_P", depth_stage);
+	AXI_FIFO<axi_trans_handle_t> response_P("response_P", depth_stage);
+	std::unique_ptr<AXI_BRIDGE> bridge;
+	if (is_partitioned)
+	{
+		bridge.reset(new AXI_BRIDGE("B1"));
+		bridge->partition = partition;
+		bridge->lookahead_ns = lookahead_ns;
+		bridge->shared = shared;
+		if (partition == 0)
+		{
+			bridge->in(request_S);
+			bridge->out(response_S);
+		}
+		else
+		{
+			bridge->in(response_P);
+			bridge->out(request_P);
+		}
+		request_tail = &request_P;
+		response_tail = &response_P;
+	}
+	// the fifos behind a stage are named after it, e.g. request_C1
+	auto append_stage = [&](const std::string& name,
+		sc_fifo_in<axi_trans_handle_t>& request_in, sc_fifo_out<axi_trans_handle_t>& response_out)
+	{
+		request_in(*request_tail);
+		response_out(*response_tail);
+		list_fifo.emplace_back(new AXI_FIFO<axi_trans_handle_t>(("request_" + name).c_str(), depth_stage));
+		request_tail = list_fifo.back().get();
+		list_fifo.emplace_back(new AXI_FIFO<axi_trans_handle_t>(("response_" + name).c_str(), depth_stage));
+		response_tail = list_fifo.back().get();
+	};
+
+	// a narrower bus segment in front of the subordinate, width in bits
+	std::unique_ptr<AXI_WIDTH_CONVERTER> conv;
+	std::unique_ptr<AXI_BUS> bus_down;
+	int width_down = config.get_int("width_converter.width", 0);
+	if (width_down > 0)
+	{
+		conv.reset(new AXI_WIDTH_CONVERTER("C1"));
+		conv->width_up = DATA_WIDTH;
+		conv->width_down = width_down;
+		append_stage("C1", conv->request_in, conv->response_out);
+		conv->request_out(*request_tail);
+		conv->response_in(*response_tail);
+
+		bus_down.reset(new AXI_BUS("bus_down"));
+		bus_down->ACLK(ACLK_subordinate);
+		bus_down->ARESETn(ARESETn);
+		append_stage("bus_down", bus_down->request_M, bus_down->response_M);
+		bus_down->request_S(*request_tail);
+		bus_down->response_S(*response_tail);
+		configure_bus(*bus_down, config, "bus_down");
+	}
+
+	// a system cache in front of the subordinate
+	std::unique_ptr<AXI_CACHE> cache;
+	if (config.get_bool("cache.enable", false))
+	{
+		cache.reset(new AXI_CACHE("L3"));
+		cache->size_bytes = config.get_int("cache.size_bytes", 32 * 1024);
+		cache->ways = config.get_int("cache.ways", 4);
+		cache->line_bytes = config.get_int("cache.line_bytes", 64);
+		std::string replacement = config.get_string("cache.replacement", "lru");
+		if (replacement == "lru")
+		{
+			cache->replacement = CACHE_REPLACE_LRU;
+		}
+		else if (replacement == "plru")
+		{
+			cache->replacement = CACHE_REPLACE_PLRU;
+		}
+		else if (replacement == "random")
+		{
+			cache->replacement = CACHE_REPLACE_RANDOM;
+		}
+		else
+		{
+			SC_REPORT_FATAL("AXI_CONFIG", ("Unknown cache.replacement " + replacement).c_str());
+		}
+		cache->is_write_back = config.get_bool("cache.write_back", true);
+		cache->is_write_allocate = config.get_bool("cache.write_allocate", true);
+		cache->hit_latency_ns = config.get_int("cache.hit_latency_ns", cache->hit_latency_ns);
+		cache->miss_latency_ns = config.get_int("cache.miss_latency_ns", cache->miss_latency_ns);
+		append_stage("L3", cache->request_in, cache->response_out);
+		cache->request_out(*request_tail);
+		cache->response_in(*response_tail);
+
+		// line fills read around the addresses of the trace
+		s.is_unmapped_zero = true;
+	}
+
+	// a prefetcher for read streams in front of the subordinate
+	std::unique_ptr<PREFETCH_ENGINE> engine;
+	std::unique_ptr<AXI_PREFETCHER> prefetcher;
+	if (config.get_bool("prefetcher.enable", false))
+	{
+		std::string name = config.get_string("prefetcher.engine", "stream");
+		if (name == "stream")
+		{
+			PREFETCH_STREAM* stream = new PREFETCH_STREAM();
+			stream->count_stream = config.get_int("prefetcher.streams", stream->count_stream);
+			stream->depth = config.get_int("prefetcher.degree", stream->depth);
+			engine.reset(stream);
+		}
+		else if (name == "next-line")
+		{
+			PREFETCH_NEXT_LINE* next_line = new PREFETCH_NEXT_LINE();
+			next_line->degree = config.get_int("prefetcher.degree", next_line->degree);
+			engine.reset(next_line);
+		}
+		else if (name == "stride")
+		{
+			PREFETCH_STRIDE* stride = new PREFETCH_STRIDE();
+			stride->degree = config.get_int("prefetcher.degree", stride->degree);
+			stride->region_bytes = config.get_int("prefetcher.region_bytes", stride->region_bytes);
+			engine.reset(stride);
+		}
+		else
+		{
+			SC_REPORT_FATAL("AXI_CONFIG", ("Unknown prefetcher.engine " + name).c_str());
+		}
+
+		prefetcher.reset(new AXI_PREFETCHER("P1"));
+		prefetcher->engine = engine.get();
+		prefetcher->block_bytes = config.get_int("prefetcher.block_bytes", prefetcher->block_bytes);
+		prefetcher->depth_buffer = config.get_int("prefetcher.depth_buffer", prefetcher->depth_buffer);
+		prefetcher->max_prefetch_outstanding = config.get_int("prefetcher.max_outstanding",
+			prefetcher->max_prefetch_outstanding);
+		append_stage("P1", prefetcher->request_in, prefetcher->response_out);
+		prefetcher->request_out(*request_tail);
+		prefetcher->response_in(*response_tail);
+
+		// prefetches read beyond the addresses of the trace
+		s.is_unmapped_zero = true;
+	}
+
+	s.request(*request_tail);
+	s.response(*response_tail);
+
+	// fast-forward of sampled simulation, through the buffers that
+	// may hold newer data than the memory image
+	m.functional_access = [&](axi_trans_t& trans)
+	{
+		if (prefetcher && trans.is_write)
+		{
+			prefetcher->drop_blocks(trans);
+		}
+		if (cache)
+		{
+			cache->functional_access(trans, s);
+			return;
+		}
+		s.access_memory(trans);
+	};
+	m.is_downstream_idle = [&]()
+	{
+		return bus.is_idle() && (!conv || (conv->is_idle() && bus_down->is_idle()))
+			&& (!cache || cache->is_idle()) && (!prefetcher || prefetcher->is_idle())
+			&& s.is_idle();
+	};
+
+	sc_trace_file* f = nullptr;
+	if (!filename_vcd.empty() && is_manager_side && count_worker == 0)
+	{
+		f = sc_create_vcd_trace_file(filename_vcd.c_str());
+		sc_trace(f, ARESETn, "ARESETn");
+		sc_trace(f, ACLK, "ACLK");
+		trace_bus(f, bus);
+	}
+
+	// Chrome trace event timeline of the transfers and transactions,
+	// for chrome://tracing or ui.perfetto.dev
+	AXI_TIMELINE timeline;
+	if (!filename_timeline.empty())
+	{
+		if (is_partitioned || count_worker > 0)
+		{
+			SC_REPORT_FATAL("AXI_CONFIG", "simulation.timeline needs one process");
+		}
+		if (!timeline.open(filename_timeline))
+		{
+			SC_REPORT_FATAL("AXI_TIMELINE", ("Cannot write " + filename_timeline).c_str());
+		}
+		bus.set_timeline(&timeline);
+		if (bus_down)
+		{
+			bus_down->set_timeline(&timeline);
+		}
+	}
+
+	s.read_latency_csv();
+	if (s_dram != nullptr)
+	{
+		s_dram->read_dram_csv();
+	}
+
+	// Batch mode runs the workloads of the batch file one after the other
+	// in this elaborated model. Otherwise the batch is the one workload
+	// of the [manager] and [subordinate] settings.
+	std::string filename_batch = config.get_string("simulation.batch", "");
+	std::vector<workload_t> list_workload;
+	auto print_batch = [&](const workload_t& workload, const ensemble_result_t& result)
+	{
+		const char* status[] = {"completed", "timeout", "crashed"};
+		std::cout << "BATCH " << result.index << ": access=" << workload.filename_access
+			<< ", " << status[result.status]
+			<< ", duration=" << result.duration_ns << " ns" << std::endl;
+	};
+	if (filename_batch.empty())
+	{
+		list_workload.push_back({m.filename_access, s.filename_memory, filename_m_after, filename_s_after});
+	}
+	else if (!read_batch_csv(filename_batch, list_workload))
+	{
+		SC_REPORT_FATAL("AXI_CONFIG", ("No workload in " + filename_batch).c_str());
+	}
+	if (count_worker < 0 || (count_worker > 0 && filename_batch.empty()))
+	{
+		SC_REPORT_FATAL("AXI_CONFIG", "simulation.workers needs simulation.batch");
+	}
+
+	// Checkpoint: the accesses due at checkpoint_ns are held back, and once
+	// the model has drained its state goes to the checkpoint file. Then the
+	// run stops or goes on. restore resumes from a checkpoint file instead
+	// of reading the access trace and the memory image.
+	std::string filename_checkpoint = config.get_string("simulation.checkpoint", "");
+	uint64_t checkpoint_ns = config.get_int("simulation.checkpoint_ns", 0);
+	bool is_checkpoint_stop = config.get_bool("simulation.checkpoint_stop", true);
+	std::string filename_restore = config.get_string("simulation.restore", "");
+	if (!filename_batch.empty() && (!filename_checkpoint.empty() || !filename_restore.empty()))
+	{
+		SC_REPORT_FATAL("AXI_CONFIG", "Checkpoints do not work in batch mode");
+	}
+	if (!filename_checkpoint.empty())
+	{
+		if (checkpoint_ns == 0)
+		{
+			SC_REPORT_FATAL("AXI_CONFIG", "simulation.checkpoint needs simulation.checkpoint_ns");
+		}
+		m.stamp_hold_ns = checkpoint_ns;
+	}
+
+	// every module with state, in the order of the file
+	auto save_checkpoint = [&](AXI_CHECKPOINT& checkpoint)
+	{
+		m.save_state(checkpoint);
+		bus.save_state(checkpoint);
+		if (conv)
+		{
+			conv->save_state(checkpoint);
+			bus_down->save_state(checkpoint);
+		}
+		if (cache)
+		{
+			cache->save_state(checkpoint);
+		}
+		if (prefetcher)
+		{
+			prefetcher->save_state(checkpoint);
+		}
+		s.save_state(checkpoint);
+		checkpoint.close();
+	};
+	auto restore_checkpoint = [&](AXI_CHECKPOINT& checkpoint)
+	{
+		m.restore_state(checkpoint);
+		bus.restore_state(checkpoint);
+		if (conv)
+		{
+			conv->restore_state(checkpoint);
+			bus_down->restore_state(checkpoint);
+		}
+		if (cache)
+		{
+			cache->restore_state(checkpoint);
+		}
+		if (prefetcher)
+		{
+			prefetcher->restore_state(checkpoint);
+		}
+		s.restore_state(checkpoint);
+		checkpoint.close();
+	};
+
+	COMPLETION done("done");
+	done.ACLK(ACLK);
+	done.limit_ns = limit_ns;
+	done.is_pausing = !filename_batch.empty() || !filename_checkpoint.empty();
+	done.watch(m);
+	done.watch(bus);
+	if (conv)
+	{
+		done.watch(*conv);
+		done.watch(*bus_down);
+	}
+	if (cache)
+	{
+		done.watch(*cache);
+	}
+	if (prefetcher)
+	{
+		done.watch(*prefetcher);
+	}
+	done.watch(s);
+	if (bridge)
+	{
+		done.watch(*bridge);
+	}
+
+	// memory images read once by the ensemble parent, by file name
+	std::unordered_map<std::string, std::unordered_map<uint64_t, bus_data_t>> map_image;
+
+	// one workload, after the previous one drained
+	size_t count_run = 0;
+	auto run_workload = [&](size_t i, ensemble_result_t& result)
+	{
+		const workload_t& workload = list_workload[i];
+
+		// The previous workload has drained, so every thread waits for
+		// new requests. Reset the state the modules keep between them.
+		if (count_run > 0)
+		{
+			m.soft_reset();
+			bus.soft_reset();
+			if (conv)
+			{
+				conv->soft_reset();
+				bus_down->soft_reset();
+			}
+			if (cache)
+			{
+				cache->soft_reset();
+			}
+			if (prefetcher)
+			{
+				prefetcher->soft_reset();
+			}
+			s.soft_reset();
+			for (AXI_FIFO<axi_trans_handle_t>* fifo : {&request_M, &response_M, &request_S, &response_S})
+			{
+				fifo->soft_reset();
+			}
+			for (auto& fifo : list_fifo)
+			{
+				fifo->soft_reset();
+			}
+		}
+		count_run ++;
+
+		m.filename_access = workload.filename_access;
+		s.filename_memory = workload.filename_memory;
+		if (filename_restore.empty())
+		{
+			if (is_manager_side)
+			{
+				m.read_access_csv();
+			}
+			auto iter = map_image.find(workload.filename_memory);
+			if (iter != map_image.end())
+			{
+				// read-only, the writes of this workload go to an overlay
+				s.set_memory_base(&iter->second);
+			}
+			else if (is_subordinate_side)
+			{
+				s.read_memory_csv();
+			}
+		}
+		else
+		{
+			// Elaborate first, it sets up the ID free list and the cache
+			// sets. The resumed trace continues after the reset.
+			AXI_CHECKPOINT checkpoint;
+			sc_start(SC_ZERO_TIME);
+			if (!checkpoint.open_read(filename_restore))
+			{
+				SC_REPORT_FATAL("AXI_CHECKPOINT", ("Cannot restore " + filename_restore).c_str());
+			}
+			checkpoint.stamp_resume_ns = r.duration_ns;
+			restore_checkpoint(checkpoint);
+			std::cout << "CHECKPOINT: restored " << filename_restore
+				<< ", taken at " << checkpoint.stamp_ns << " ns" << std::endl;
+		}
+		done.restart();
+
+		// wall clock time of the simulation, per bus clock
+		auto wall_begin = std::chrono::steady_clock::now();
+		sc_start();
+		if (bridge)
+		{
+			bridge->finish();
+		}
+		if (!filename_checkpoint.empty() && done.is_completed && !m.queue_access.empty())
+		{
+			// drained with the rest of the trace held back
+			AXI_CHECKPOINT checkpoint;
+			uint64_t stamp_now_ns = sc_time_stamp().value() / 1000; // ps to ns convert.
+			if (!checkpoint.open_write(filename_checkpoint, stamp_now_ns))
+			{
+				SC_REPORT_FATAL("AXI_CHECKPOINT", ("Cannot save " + filename_checkpoint).c_str());
+			}
+			save_checkpoint(checkpoint);
+			std::cout << "CHECKPOINT: saved " << filename_checkpoint
+				<< " at " << stamp_now_ns << " ns" << std::endl;
+			if (!is_checkpoint_stop)
+			{
+				m.release();
+				done.restart();
+				sc_start();
+			}
+		}
+		else if (!filename_checkpoint.empty() && done.is_completed)
+		{
+			std::cerr << "Error: no checkpoint, the trace ends before "
+				<< checkpoint_ns << " ns" << std::endl;
+		}
+		auto wall_end = std::chrono::steady_clock::now();
+
+		result.index = i;
+		result.status = done.is_completed ? ENSEMBLE_COMPLETED : ENSEMBLE_TIMEOUT;
+		result.pid = getpid();
+		result.duration_ns = done.stamp_stop_ns - done.stamp_start_ns;
+		result.count_clock = bus.count_clock;
+		result.wall_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(wall_end - wall_begin).count();
+		result.count_retired = m.count_retired;
+		result.sum_latency_ns = m.sum_latency_ns;
+		result.max_latency_ns = m.max_latency_ns;
+		result.count_bytes = m.count_bytes;
+
+		if (!filename_batch.empty() && count_worker == 0)
+		{
+			print_batch(workload, result);
+		}
+
+		if (is_partitioned && partition == 0)
+		{
+			// the subordinate side writes its memory image and reports first,
+			// unless the bridge has reaped it already
+			waitpid(pid_child, nullptr, 0);
+		}
+
+		// the memory images still go to files in the workers, the
+		// statistics only come back in the result
+		if (is_manager_side && !workload.filename_m_after.empty())
+		{
+			m.write_memory_csv(workload.filename_m_after);
+		}
+		if (is_subordinate_side)
+		{
+			if (cache)
+			{
+				cache->flush_to(s);
+			}
+			if (!workload.filename_s_after.empty())
+			{
+				s.write_memory_csv(workload.filename_s_after);
+			}
+		}
+		if (count_worker > 0)
+		{
+			return;
+		}
+
+		if (is_manager_side)
+		{
+			m.report_stats();
+			bus.report_stats();
+		}
+		if (is_subordinate_side)
+		{
+			if (conv)
+			{
+				conv->report_stats();
+				bus_down->report_stats();
+			}
+			if (cache)
+			{
+				cache->report_stats();
+			}
+			if (prefetcher)
+			{
+				prefetcher->report_stats();
+			}
+			s.report_stats();
+		}
+		if (bridge)
+		{
+			bridge->report_stats();
+		}
+
+		// the fifos of this side, the bus ends first
+		if (is_manager_side)
+		{
+			for (AXI_FIFO<axi_trans_handle_t>* fifo : {&request_M, &response_M, &request_S, &response_S})
+			{
+				fifo->report_stats();
+			}
+		}
+		if (is_partitioned && is_subordinate_side)
+		{
+			request_P.report_stats();
+			response_P.report_stats();
+		}
+		if (is_subordinate_side)
+		{
+			for (auto& fifo : list_fifo)
+			{
+				fifo->report_stats();
+			}
+		}
+		// the transactions the fifos carry, in use is 0 once drained
+		std::cout << "FIFO pool: transactions=" << axi_trans_count_allocated()
+			<< ", in_use=" << axi_trans_count_in_use() << std::endl;
+	};
+
+	std::vector<ensemble_result_t> list_result(list_workload.size(), ensemble_result_t{});
+	size_t count_run_total = 0;
+	auto wall_ensemble_begin = std::chrono::steady_clock::now();
+	if (count_worker > 0)
+	{
+		// Elaborate and read the memory images before the workers are
+		// forked, they start from this state and share its pages.
+		sc_start(SC_ZERO_TIME);
+		for (const workload_t& workload : list_workload)
+		{
+			if (map_image.count(workload.filename_memory) == 0)
+			{
+				s.filename_memory = workload.filename_memory;
+				s.read_memory_csv();
+				map_image[workload.filename_memory] = std::move(s.map_memory);
+				s.map_memory.clear();
+			}
+		}
+
+		AXI_ENSEMBLE ensemble;
+		ensemble.count_worker = count_worker;
+		ensemble.run = run_workload;
+		ensemble.execute(list_workload.size(), list_result);
+		count_run_total = list_workload.size();
+		for (size_t i = 0; i < list_workload.size(); i++)
+		{
+			print_batch(list_workload[i], list_result[i]);
+		}
+	}
+	else
+	{
+		for (size_t i = 0; i < list_workload.size(); i++)
+		{
+			run_workload(i, list_result[i]);
+			count_run_total ++;
+			if (list_result[i].status != ENSEMBLE_COMPLETED)
+			{
+				// the simulation is stopped, the rest of the batch cannot run
+				break;
+			}
+		}
+	}
+	auto wall_ensemble_end = std::chrono::steady_clock::now();
 
-	m.read_access_csv();
-	s.read_memory_csv();
-	
-	sc_start(SIMULATION_TIME, SC_NS);
+	uint64_t wall_ns = 0;
+	uint64_t count_clock = 0;
+	size_t count_completed = 0;
+	uint64_t count_retired = 0;
+	uint64_t sum_latency_ns = 0;
+	uint64_t max_latency_ns = 0;
+	for (size_t i = 0; i < count_run_total; i++)
+	{
+		const ensemble_result_t& result = list_result[i];
+		wall_ns += result.wall_ns;
+		count_clock += result.count_clock;
+		count_completed += result.status == ENSEMBLE_COMPLETED;
+		count_retired += result.count_retired;
+		sum_latency_ns += result.sum_latency_ns;
+		max_latency_ns = std::max(max_latency_ns, result.max_latency_ns);
+	}
 
-	m.write_memory_csv();
-	s.write_memory_csv();
+	if (!filename_batch.empty())
+	{
+		std::cout << "BATCH: completed=" << count_completed
+			<< " of " << list_workload.size() << " workloads" << std::endl;
+	}
+	if (count_worker > 0)
+	{
+		uint64_t wall_ensemble_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+			wall_ensemble_end - wall_ensemble_begin).count();
+		std::cout << "ENSEMBLE: workers=" << count_worker
+			<< ", retired=" << count_retired
+			<< ", avg_latency=" << (count_retired ? (double) sum_latency_ns / count_retired : 0) << " ns"
+			<< ", max_latency=" << max_latency_ns << " ns" << std::endl;
+		std::cout << "ENSEMBLE: elapsed=" << wall_ensemble_ns / 1000000.0 << " ms"
+			<< ", speedup=" << (wall_ensemble_ns ? (double) wall_ns / wall_ensemble_ns : 0) << std::endl;
+	}
+	// the wall clock time is that of the manager side
+	if (!is_manager_side)
+	{
+		return (0);
+	}
+	std::cout << "BENCH: wall=" << wall_ns / 1000000.0 << " ms"
+		<< ", clocks=" << count_clock
+		<< ", per_clock=" << (count_clock ? (double) wall_ns / count_clock : 0)
+		<< " ns" << std::endl;
 
-	sc_close_vcd_trace_file(f);
+	if (f != nullptr)
+	{
+		sc_close_vcd_trace_file(f);
+	}
+	timeline.close();
 	return (0);
 }
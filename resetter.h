@@ -3,6 +3,8 @@ SC_MODULE(RESETTER)
 	// output ports
 	sc_out<bool>	ARESETn;
 
+	uint64_t duration_ns = 10;
+
 	SC_CTOR(RESETTER)
 	{
 		SC_THREAD(thread_execute);
@@ -11,7 +13,7 @@ SC_MODULE(RESETTER)
 	void thread_execute()
 	{
 		ARESETn = false;
-		wait(10, SC_NS);
+		wait(duration_ns, SC_NS);
 		ARESETn = true;
 	}
 };
@@ -0,0 +1,218 @@
+#include <iostream>
+#include <string>
+#include <chrono>
+#include <functional>
+#include <vector>
+#include <systemc>
+
+using namespace sc_core;
+using namespace sc_dt;
+
+// Micro benchmarks of AXI_BUS internals, see make microbench.
+//
+// The same minimal bus as test/unittest.cpp. Each benchmark repeats one
+// operation and reports the wall clock time per operation, to compare
+// two commits of a refactoring on the same machine.
+
+#include "axi_param.h"
+#include "axi_bus.h"
+
+static axi_addr_info_t make_addr_info(uint32_t id, uint64_t addr, int length)
+{
+	axi_addr_info_t info = {};
+	info.id = id;
+	info.addr = addr;
+	info.len = length - 1;
+	info.burst = AXI_BURST_INCR;
+	info.size = AXI_SIZE_FULL;
+	return info;
+}
+
+SC_MODULE(MICROBENCH)
+{
+	AXI_BUS* bus = nullptr;
+	sc_fifo_out<axi_trans_handle_t> response_S;	// into the bus
+	uint64_t count_repeat = 100000;
+
+	SC_CTOR(MICROBENCH)
+	{
+		SC_THREAD(thread_bench);
+	}
+
+	// runs operation count times, one operation per call
+	void measure(const std::string& name, uint64_t count, std::function<void()> operation)
+	{
+		auto wall_begin = std::chrono::steady_clock::now();
+		for (uint64_t i = 0; i < count; i++)
+		{
+			operation();
+		}
+		auto wall_end = std::chrono::steady_clock::now();
+		uint64_t wall_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(wall_end - wall_begin).count();
+
+		std::cout << "MICROBENCH " << name << ": ops=" << count
+			<< ", wall=" << wall_ns / 1000000.0 << " ms"
+			<< ", per_op=" << (double) wall_ns / count << " ns" << std::endl;
+	}
+
+	void thread_bench()
+	{
+		// after the reset of the bus at time 0
+		for (int i = 0; i < 4; i++)
+		{
+			wait(SC_ZERO_TIME);
+		}
+
+		bench_id();
+		bench_progress();
+		bench_progress_update();
+		bench_channel_sender();
+		bench_response_S(1);
+		bench_response_S(64);
+		bench_response_S(256);
+		sc_stop();
+	}
+
+	void bench_id()
+	{
+		measure("allocate_release_id", count_repeat, [&]()
+		{
+			bus->release_transaction_id(bus->allocate_transaction_id());
+		});
+	}
+
+	void bench_progress()
+	{
+		measure("progress_create_delete", count_repeat, [&]()
+		{
+			uint32_t id = bus->allocate_transaction_id();
+			bus->progress_create(make_addr_info(id, 0x1000, 16), false);
+			bus->progress_delete(id);
+		});
+	}
+
+	// one operation is one beat of a 256 beat read
+	void bench_progress_update()
+	{
+		AXI_RING<axi_data_info_t> q;
+		q.set_capacity(AXI_TRANSACTION_LENGTH_MAX);
+		axi_data_info_t info = {};
+		info.strb = BUS_STRB_FULL;
+
+		uint32_t id = 0;
+		int count_beat = 0;
+		measure("progress_update_per_beat", count_repeat * 10, [&]()
+		{
+			if (count_beat == 0)
+			{
+				id = bus->allocate_transaction_id();
+				bus->progress_create(make_addr_info(id, 0x10000, AXI_TRANSACTION_LENGTH_MAX), false);
+			}
+			info.id = id;
+			info.data = count_beat;
+			info.is_last = (count_beat == AXI_TRANSACTION_LENGTH_MAX - 1);
+			q.push(info);
+			if (bus->progress_update(q))
+			{
+				q.pop();
+				bus->progress_delete(id);
+				count_beat = 0;
+				return;
+			}
+			count_beat ++;
+		});
+
+		// the last read may be unfinished
+		if (count_beat > 0)
+		{
+			bus->progress_delete(id);
+		}
+	}
+
+	// one operation is one beat sent and taken, without the delta cycle
+	void bench_channel_sender()
+	{
+		AXI_RING<axi_data_info_t> q;
+		q.set_capacity(4);
+		axi_data_info_t info = {};
+		info.strb = BUS_STRB_FULL;
+
+		bus->is_transferred[CHANNEL_W] = true;
+		measure("channel_sender_W", count_repeat * 10, [&]()
+		{
+			q.push(info);
+			bus->channel_sender(CHANNEL_W, q);
+		});
+		bus->is_transferred[CHANNEL_W] = false;
+	}
+
+	// The response of the subordinate is matched against the transactions
+	// in progress. One operation includes the fifo write and the delta
+	// cycles until the bus thread has queued the R beat.
+	void bench_response_S(int count_outstanding)
+	{
+		std::vector<uint32_t> list_id;
+		for (int i = 0; i < count_outstanding; i++)
+		{
+			uint32_t id = bus->allocate_transaction_id();
+			bus->progress_create(make_addr_info(id, 0x100000 + i * 0x100, 1), false);
+			list_id.push_back(id);
+		}
+
+		axi_trans_t trans = {};
+		trans.length = 1;
+		trans.burst = AXI_BURST_INCR;
+		trans.size = AXI_SIZE_FULL;
+		trans.is_write = false;
+		uint64_t index = 0;
+		measure("response_S_outstanding_" + std::to_string(count_outstanding), count_repeat / 10, [&]()
+		{
+			trans.addr = 0x100000 + (index ++ % count_outstanding) * 0x100;
+			axi_trans_write(response_S, trans);
+			while (bus->q_send_R.empty())
+			{
+				wait(SC_ZERO_TIME);
+			}
+			bus->q_send_R.pop();
+		});
+
+		for (uint32_t id : list_id)
+		{
+			bus->progress_delete(id);
+		}
+	}
+};
+
+int sc_main(int argc, char* argv[])
+{
+	AXI_BUS::is_debug = false;
+	AXI_BUS::is_debug_channel = false;
+	AXI_BUS::is_debug_progress = false;
+
+	// no clock edge ever, and no reset after time 0
+	sc_signal<bool> ACLK;
+	sc_signal<bool> ARESETn;
+	sc_fifo<axi_trans_handle_t> request_M;
+	sc_fifo<axi_trans_handle_t> response_M;
+	sc_fifo<axi_trans_handle_t> request_S;
+	sc_fifo<axi_trans_handle_t> response_S;
+
+	AXI_BUS bus("bus");
+	bus.ACLK(ACLK);
+	bus.ARESETn(ARESETn);
+	bus.request_M(request_M);
+	bus.response_M(response_M);
+	bus.request_S(request_S);
+	bus.response_S(response_S);
+
+	MICROBENCH b("b");
+	b.bus = &bus;
+	b.response_S(response_S);
+	if (argc > 1)
+	{
+		b.count_repeat = std::stoull(argv[1]);
+	}
+
+	sc_start();
+	return (0);
+}
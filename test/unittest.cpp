@@ -0,0 +1,449 @@
+#include <iostream>
+#include <string>
+#include <functional>
+#include <vector>
+#include <systemc>
+
+using namespace sc_core;
+using namespace sc_dt;
+
+// Unit tests of AXI_BUS internals, see make unittest.
+//
+// The bus is elaborated alone: its clock never ticks and its fifos have
+// no other end, so its threads stay blocked and the tests call the
+// methods directly, from a thread of their own. Fatal reports throw,
+// so the tests can expect them.
+
+#include "axi_param.h"
+#include "axi_bus.h"
+
+static int count_pass = 0;
+static int count_fail = 0;
+
+static void check(bool condition, const char* text, int line)
+{
+	if (condition)
+	{
+		count_pass ++;
+		return;
+	}
+	count_fail ++;
+	std::cout << "FAIL line " << line << ": " << text << std::endl;
+}
+
+#define CHECK(condition)	check((condition), #condition, __LINE__)
+
+// the statement must end in SC_REPORT_FATAL
+#define CHECK_FATAL(statement)						\
+	do												\
+	{												\
+		bool is_fatal = false;						\
+		try											\
+		{											\
+			statement;								\
+		}											\
+		catch (const sc_report&)					\
+		{											\
+			is_fatal = true;						\
+		}											\
+		check(is_fatal, "fatal: " #statement, __LINE__);	\
+	} while (0)
+
+static axi_addr_info_t make_addr_info(uint32_t id, uint64_t addr, int length)
+{
+	axi_addr_info_t info = {};
+	info.id = id;
+	info.addr = addr;
+	info.len = length - 1;
+	info.burst = AXI_BURST_INCR;
+	info.size = AXI_SIZE_FULL;
+	return info;
+}
+
+static axi_data_info_t make_data_info(uint32_t id, uint64_t value, bool is_last)
+{
+	axi_data_info_t info = {};
+	info.id = id;
+	info.data = value;
+	info.strb = BUS_STRB_FULL;
+	info.is_last = is_last;
+	return info;
+}
+
+SC_MODULE(UNITTEST)
+{
+	AXI_BUS* bus = nullptr;
+	sc_fifo_out<axi_trans_handle_t> response_S;	// into the bus
+	sc_fifo_in<axi_trans_handle_t> request_S;		// out of the bus
+
+	std::vector<std::pair<std::string, std::function<void()>>> list_test;
+
+	SC_CTOR(UNITTEST)
+	{
+		SC_THREAD(thread_test);
+	}
+
+	void thread_test()
+	{
+		// after the reset of the bus at time 0
+		for (int i = 0; i < 4; i++)
+		{
+			wait(SC_ZERO_TIME);
+		}
+
+		for (auto& test : list_test)
+		{
+			int count_fail_before = count_fail;
+			test.second();
+			std::cout << "UNITTEST " << test.first << ": "
+				<< (count_fail == count_fail_before ? "pass" : "FAIL") << std::endl;
+		}
+		sc_stop();
+	}
+
+	void wait_deltas()
+	{
+		for (int i = 0; i < 10; i++)
+		{
+			wait(SC_ZERO_TIME);
+		}
+	}
+
+	// an empty data ring of the given capacity
+	static void reset_ring(AXI_RING<axi_data_info_t>& q, size_t capacity)
+	{
+		q.clear();
+		q.set_capacity(capacity);
+	}
+
+	void test_progress_create_delete()
+	{
+		size_t count_free = bus->q_id_free.size();
+		uint32_t id = bus->allocate_transaction_id();
+		CHECK(bus->q_id_free.size() == count_free - 1);
+
+		CHECK(bus->progress_create(make_addr_info(id, 0x1000, 4), false));
+		CHECK(bus->map_progress.count(id) == 1);
+		CHECK(std::get<0>(bus->map_progress[id]).length == 4);
+		CHECK(std::get<1>(bus->map_progress[id]) == 0);
+
+		// an ID is in progress once
+		CHECK_FATAL(bus->progress_create(make_addr_info(id, 0x2000, 1), false));
+
+		bus->progress_delete(id);
+		CHECK(bus->map_progress.empty());
+		CHECK(bus->q_id_free.size() == count_free);
+		CHECK(bus->q_id_free.back() == id);
+
+		CHECK_FATAL(bus->progress_delete(id));
+	}
+
+	void test_progress_update_single()
+	{
+		AXI_RING<axi_data_info_t> q;
+		reset_ring(q, 4);
+		CHECK(!bus->progress_update(q));
+
+		uint32_t id = bus->allocate_transaction_id();
+		bus->progress_create(make_addr_info(id, 0x40, 1), false);
+		q.push(make_data_info(id, 0x1234, true));
+		CHECK(bus->progress_update(q));
+		CHECK(q.size() == 1);	// the caller pops the last beat
+		CHECK(std::get<0>(bus->map_progress[id]).data[0] == 0x1234);
+
+		// full, the last beat is seen again until it is popped
+		CHECK(bus->progress_update(q));
+		CHECK(std::get<1>(bus->map_progress[id]) == 1);
+		q.pop();
+		bus->progress_delete(id);
+	}
+
+	void test_progress_update_256()
+	{
+		AXI_RING<axi_data_info_t> q;
+		reset_ring(q, AXI_TRANSACTION_LENGTH_MAX);
+
+		uint32_t id = bus->allocate_transaction_id();
+		bus->progress_create(make_addr_info(id, 0x10000, AXI_TRANSACTION_LENGTH_MAX), false);
+		for (int i = 0; i < AXI_TRANSACTION_LENGTH_MAX; i++)
+		{
+			q.push(make_data_info(id, 1000 + i, i == AXI_TRANSACTION_LENGTH_MAX - 1));
+		}
+
+		int count_false = 0;
+		while (!bus->progress_update(q))
+		{
+			count_false ++;
+		}
+		CHECK(count_false == AXI_TRANSACTION_LENGTH_MAX - 1);
+		CHECK(q.size() == 1);
+
+		const axi_trans_t& trans = std::get<0>(bus->map_progress[id]);
+		bool is_in_order = true;
+		for (int i = 0; i < AXI_TRANSACTION_LENGTH_MAX; i++)
+		{
+			is_in_order = is_in_order && trans.data[i] == 1000 + i;
+		}
+		CHECK(is_in_order);
+		q.pop();
+		bus->progress_delete(id);
+	}
+
+	void test_progress_update_interleaved()
+	{
+		AXI_RING<axi_data_info_t> q;
+		reset_ring(q, 16);
+
+		uint32_t id_a = bus->allocate_transaction_id();
+		uint32_t id_b = bus->allocate_transaction_id();
+		bus->progress_create(make_addr_info(id_a, 0x100, 4), false);
+		bus->progress_create(make_addr_info(id_b, 0x200, 4), false);
+
+		// beats of the two reads alternate, the last ones complete both
+		for (int i = 0; i < 4; i++)
+		{
+			q.push(make_data_info(id_a, 0xa0 + i, i == 3));
+			q.push(make_data_info(id_b, 0xb0 + i, i == 3));
+			if (i < 3)
+			{
+				CHECK(!bus->progress_update(q));
+				CHECK(!bus->progress_update(q));
+			}
+		}
+		CHECK(bus->progress_update(q));
+		CHECK(q.front().id == id_a);
+		q.pop();
+		CHECK(bus->progress_update(q));
+		CHECK(q.front().id == id_b);
+		q.pop();
+
+		const axi_trans_t& trans_a = std::get<0>(bus->map_progress[id_a]);
+		const axi_trans_t& trans_b = std::get<0>(bus->map_progress[id_b]);
+		for (int i = 0; i < 4; i++)
+		{
+			CHECK(trans_a.data[i] == 0xa0 + i);
+			CHECK(trans_b.data[i] == 0xb0 + i);
+		}
+		bus->progress_delete(id_a);
+		bus->progress_delete(id_b);
+	}
+
+	void test_progress_update_errors()
+	{
+		AXI_RING<axi_data_info_t> q;
+		reset_ring(q, 8);
+
+		// LAST on the second of four beats
+		uint32_t id = bus->allocate_transaction_id();
+		bus->progress_create(make_addr_info(id, 0x300, 4), false);
+		q.push(make_data_info(id, 1, false));
+		q.push(make_data_info(id, 2, true));
+		CHECK(!bus->progress_update(q));
+		CHECK_FATAL(bus->progress_update(q));
+		bus->progress_delete(id);
+
+		// a third beat of a two beat burst, without LAST
+		reset_ring(q, 8);
+		id = bus->allocate_transaction_id();
+		bus->progress_create(make_addr_info(id, 0x400, 2), false);
+		q.push(make_data_info(id, 1, false));
+		q.push(make_data_info(id, 2, false));
+		q.push(make_data_info(id, 3, false));
+		CHECK(!bus->progress_update(q));
+		CHECK(!bus->progress_update(q));
+		CHECK_FATAL(bus->progress_update(q));
+		bus->progress_delete(id);
+
+		// a beat of an ID not in progress
+		reset_ring(q, 8);
+		q.push(make_data_info(id, 1, true));
+		CHECK_FATAL(bus->progress_update(q));
+	}
+
+	// W beats may arrive before their AW, e.g. with ready_aw=random:P
+	// and W always ready. They wait in q_recv_W until the AW is taken.
+
+	void test_request_S_w_before_aw()
+	{
+		uint32_t id = bus->allocate_transaction_id();
+		bus->q_recv_W.push(make_data_info(id, 0x71, false));
+		bus->q_recv_W.push(make_data_info(id, 0x72, true));
+
+		bus->transaction_request_S();
+		bus->transaction_request_S();
+		CHECK(bus->q_recv_W.size() == 2);
+		CHECK(bus->map_progress.count(id) == 0);
+
+		bus->q_recv_AW.push(make_addr_info(id, 0x500, 2));
+		bus->transaction_request_S();
+		CHECK(bus->map_progress.count(id) == 1);
+		bus->transaction_request_S();
+		CHECK(bus->q_recv_W.empty());
+		wait_deltas();
+
+		CHECK(request_S.num_available() == 1);
+		if (request_S.num_available() == 1)
+		{
+			axi_trans_t trans;
+			axi_trans_read(request_S, trans);
+			CHECK(trans.is_write && trans.addr == 0x500 && trans.length == 2);
+			CHECK(trans.data[0] == 0x71 && trans.data[1] == 0x72);
+		}
+		CHECK(axi_trans_count_in_use() == 0);
+		bus->progress_delete(id);
+	}
+
+	// The response of the subordinate finds its ID by address and
+	// direction, whatever the order of the transactions in progress.
+
+	void test_response_S_matching()
+	{
+		uint32_t id_read_1 = bus->allocate_transaction_id();
+		uint32_t id_read_2 = bus->allocate_transaction_id();
+		uint32_t id_write = bus->allocate_transaction_id();
+		bus->progress_create(make_addr_info(id_read_1, 0x1000, 2), false);
+		bus->progress_create(make_addr_info(id_read_2, 0x2000, 2), false);
+		bus->progress_create(make_addr_info(id_write, 0x2000, 1), true);
+
+		axi_trans_t trans = {};
+		trans.addr = 0x2000;
+		trans.length = 2;
+		trans.burst = AXI_BURST_INCR;
+		trans.size = AXI_SIZE_FULL;
+		trans.is_write = false;
+		trans.data[0] = 0x55;
+		trans.data[1] = 0x66;
+		axi_trans_write(response_S, trans);
+		wait_deltas();
+
+		// the bus gives the pool entry back once the beats are queued
+		CHECK(axi_trans_count_in_use() == 0);
+		CHECK(bus->q_send_R.size() == 2);
+		if (bus->q_send_R.size() == 2)
+		{
+			CHECK(bus->q_send_R.front().id == id_read_2);
+			CHECK(bus->q_send_R.front().data == 0x55);
+			CHECK(!bus->q_send_R.front().is_last);
+			bus->q_send_R.pop();
+			CHECK(bus->q_send_R.front().data == 0x66);
+			CHECK(bus->q_send_R.front().is_last);
+		}
+		bus->q_send_R.clear();
+
+		// the same address, but a write
+		trans.length = 1;
+		trans.is_write = true;
+		axi_trans_write(response_S, trans);
+		wait_deltas();
+		CHECK(bus->q_send_B.size() == 1);
+		if (!bus->q_send_B.empty())
+		{
+			CHECK(bus->q_send_B.front().id == id_write);
+		}
+		bus->q_send_B.clear();
+
+		bus->progress_delete(id_read_1);
+		bus->progress_delete(id_read_2);
+		bus->progress_delete(id_write);
+	}
+
+	// VALID rises with the first beat, holds while the receiver has not
+	// taken it, moves on after a transfer and falls when the queue is empty.
+
+	void test_channel_sender()
+	{
+		AXI_RING<axi_addr_info_t> q;
+		q.set_capacity(4);
+		axi_addr_info_t info = {};
+
+		bus->is_transferred[CHANNEL_AR] = false;
+		bus->channel_sender(CHANNEL_AR, q);
+		wait(SC_ZERO_TIME);
+		CHECK(!bus->is_valid(CHANNEL_AR));
+
+		q.push(make_addr_info(1, 0x100, 1));
+		q.push(make_addr_info(2, 0x200, 1));
+		bus->channel_sender(CHANNEL_AR, q);
+		wait(SC_ZERO_TIME);
+		CHECK(bus->is_valid(CHANNEL_AR));
+		CHECK(q.size() == 1);
+		bus->recv_info(CHANNEL_AR, info);
+		CHECK(info.id == 1 && info.addr == 0x100);
+
+		// not taken yet, the beat stays
+		bus->channel_sender(CHANNEL_AR, q);
+		wait(SC_ZERO_TIME);
+		CHECK(bus->is_valid(CHANNEL_AR));
+		CHECK(q.size() == 1);
+		bus->recv_info(CHANNEL_AR, info);
+		CHECK(info.id == 1);
+
+		// taken, the next one follows back to back
+		bus->is_transferred[CHANNEL_AR] = true;
+		bus->channel_sender(CHANNEL_AR, q);
+		wait(SC_ZERO_TIME);
+		CHECK(bus->is_valid(CHANNEL_AR));
+		CHECK(q.empty());
+		bus->recv_info(CHANNEL_AR, info);
+		CHECK(info.id == 2 && info.addr == 0x200);
+
+		// not taken and nothing more, VALID holds
+		bus->is_transferred[CHANNEL_AR] = false;
+		bus->channel_sender(CHANNEL_AR, q);
+		wait(SC_ZERO_TIME);
+		CHECK(bus->is_valid(CHANNEL_AR));
+
+		// taken and nothing more, idle with the payload zeroed
+		bus->is_transferred[CHANNEL_AR] = true;
+		bus->channel_sender(CHANNEL_AR, q);
+		wait(SC_ZERO_TIME);
+		CHECK(!bus->is_valid(CHANNEL_AR));
+		bus->recv_info(CHANNEL_AR, info);
+		CHECK(info.id == 0 && info.addr == 0);
+		bus->is_transferred[CHANNEL_AR] = false;
+	}
+};
+
+int sc_main(int argc, char* argv[])
+{
+	sc_report_handler::set_actions(SC_FATAL, SC_THROW);
+	AXI_BUS::is_debug = false;
+	AXI_BUS::is_debug_channel = false;
+	AXI_BUS::is_debug_progress = false;
+
+	// no clock edge ever, and no reset after time 0
+	sc_signal<bool> ACLK;
+	sc_signal<bool> ARESETn;
+	sc_fifo<axi_trans_handle_t> request_M;
+	sc_fifo<axi_trans_handle_t> response_M;
+	sc_fifo<axi_trans_handle_t> request_S;
+	sc_fifo<axi_trans_handle_t> response_S;
+
+	AXI_BUS bus("bus");
+	bus.ACLK(ACLK);
+	bus.ARESETn(ARESETn);
+	bus.request_M(request_M);
+	bus.response_M(response_M);
+	bus.request_S(request_S);
+	bus.response_S(response_S);
+
+	UNITTEST t("t");
+	t.bus = &bus;
+	t.response_S(response_S);
+	t.request_S(request_S);
+	t.list_test = {
+		{"progress_create_delete", [&]() { t.test_progress_create_delete(); }},
+		{"progress_update_single", [&]() { t.test_progress_update_single(); }},
+		{"progress_update_256", [&]() { t.test_progress_update_256(); }},
+		{"progress_update_interleaved", [&]() { t.test_progress_update_interleaved(); }},
+		{"progress_update_errors", [&]() { t.test_progress_update_errors(); }},
+		{"request_S_w_before_aw", [&]() { t.test_request_S_w_before_aw(); }},
+		{"response_S_matching", [&]() { t.test_response_S_matching(); }},
+		{"channel_sender", [&]() { t.test_channel_sender(); }},
+	};
+
+	sc_start();
+
+	std::cout << "UNITTEST: passed=" << count_pass << ", failed=" << count_fail << std::endl;
+	return (count_fail == 0 ? 0 : 1);
+}